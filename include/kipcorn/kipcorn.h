@@ -3,11 +3,40 @@
 
 #define _GNU_SOURCE 1
 
+// Written by make with the switches the library was built with, so consumers always
+// see the same kip_window_data layout and API as the library.
+#include <kipcorn/kipcorn_config.h>
+
+#if KIPCORN_ENABLE_CLIPBOARD && !KIPCORN_ENABLE_THREADS
+#error "KIPCORN_ENABLE_CLIPBOARD requires KIPCORN_ENABLE_THREADS"
+#endif
+
+#if defined(__GNUC__)
+#define KIPCORN_API __attribute__((visibility("default")))
+#else
+#define KIPCORN_API
+#endif
+
 #include <xdg-shell.h>
+#if KIPCORN_ENABLE_DECORATIONS
 #include <xdg-decoration-unstable-v1.h>
+#endif
+#if KIPCORN_ENABLE_LAYER_SHELL
+#include <wlr-layer-shell-unstable-v1.h>
+#endif
+#if KIPCORN_ENABLE_TEARING_CONTROL
+#include <tearing-control-v1.h>
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+#include <content-type-v1.h>
+#endif
+#if KIPCORN_ENABLE_XKB
 #include <xkbcommon/xkbcommon.h>
+#endif
+#if KIPCORN_ENABLE_EGL
 #include <wayland-egl.h>
 #include <EGL/egl.h>
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <sys/poll.h>
@@ -128,6 +157,15 @@ typedef enum kip_key {
     KIPCORN_KEY_RIGHTMETA = 126,
 } kip_key;
 
+typedef enum kip_modifier {
+    KIPCORN_MODIFIER_SHIFT = 1 << 0,
+    KIPCORN_MODIFIER_CAPS_LOCK = 1 << 1,
+    KIPCORN_MODIFIER_CTRL = 1 << 2,
+    KIPCORN_MODIFIER_ALT = 1 << 3,
+    KIPCORN_MODIFIER_NUM_LOCK = 1 << 4,
+    KIPCORN_MODIFIER_LOGO = 1 << 5,
+} kip_modifier;
+
 typedef enum kip_graphics_backend {
     KIPCORN_GRAPHICS_BACKEND_NONE,
     KIPCORN_GRAPHICS_BACKEND_SOFTWARE,
@@ -135,37 +173,92 @@ typedef enum kip_graphics_backend {
     KIPCORN_GRAPHICS_BACKEND_VULKAN,
 } kip_graphics_backend;
 
+#if KIPCORN_ENABLE_CONTENT_TYPE
+typedef enum kip_content_type {
+    KIPCORN_CONTENT_TYPE_NONE,
+    KIPCORN_CONTENT_TYPE_PHOTO,
+    KIPCORN_CONTENT_TYPE_VIDEO,
+    KIPCORN_CONTENT_TYPE_GAME,
+} kip_content_type;
+#endif
+
 typedef uint32_t kip_window;
 typedef wl_fixed_t kip_fixed_point;
 
+#if KIPCORN_ENABLE_EGL
+typedef EGLContext kip_egl_context;
+#else
+typedef void* kip_egl_context;
+#endif
+
+typedef void (*kip_tile_callback)(kip_window window, uint8_t* pixels, uint32_t stride, uint32_t x, uint32_t y, uint32_t width, uint32_t height, void* userData);
+
+#if KIPCORN_ENABLE_CLIPBOARD
+typedef void (*kip_transfer_callback)(kip_window window, const char* mimeType, int32_t fd, uint64_t size, bool success, void* userData);
+#endif
+
 typedef struct kip_window_data {
     struct wl_surface* waylandSurface;
     struct xdg_surface* xdgSurface;
     struct wl_callback* callback;
     struct xdg_toplevel* toplevel;
+#if KIPCORN_ENABLE_DECORATIONS
     struct zxdg_toplevel_decoration_v1* decorations;
+#endif
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    struct wp_tearing_control_v1* tearingControl;
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+    struct wp_content_type_v1* contentType;
+#endif
 
     struct wl_buffer* buffer;
     uint8_t* pixels;
 
+#if KIPCORN_ENABLE_EGL
     struct wl_egl_window* eglWindow;
     EGLSurface eglSurface;
     EGLContext eglContext;
+#endif
 
     kip_graphics_backend graphicsBackend;
     uint16_t width;
     uint16_t height;
 
+    uint16_t damageX;
+    uint16_t damageY;
+    uint16_t damageWidth;
+    uint16_t damageHeight;
+
+#if KIPCORN_ENABLE_KEYBOARD
     bool keyStates[139];
+#endif
 
+    uint64_t frameCallbackTime;
+    uint64_t renderStartTime;
+    uint64_t renderDuration;
+    uint64_t refreshInterval;
+    uint64_t shortestFrameInterval;
+    uint64_t nextShortestFrameInterval;
+    uint64_t frameSchedulingMargin;
+    uint32_t frameCallbackTimestamp;
+    uint32_t frameIntervalSamples;
+
+#if KIPCORN_ENABLE_POINTER
     kip_fixed_point pointerX;
     kip_fixed_point pointerY;
+#endif
 
+    bool damaged;
     bool decorationsEnabled;
     bool frameCallbackPending;
     bool frameCanRender;
+    bool frameScheduling;
     bool open;
     bool vsync;
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    bool allowTearing;
+#endif
     bool focused;
 } kip_window_data;
 
@@ -173,30 +266,90 @@ typedef struct kip_window_data {
 extern "C" {
 #endif
 
-void kip_init();
-kip_window kip_create_window(uint32_t width, uint32_t height, const char* title, kip_graphics_backend graphicsBackend, bool vsync, bool windowDecorations, bool inputPassthrough, EGLContext shareContext);
-void kip_set_vsync(kip_window window, bool vsync);
-bool kip_get_vsync(kip_window window);
-void kip_make_egl_context_current(EGLContext context);
-void kip_make_egl_surface_current(kip_window window);
-uint8_t* kip_get_pixels(kip_window window);
-struct wl_display* kip_get_wayland_display();
-struct wl_surface* kip_get_wayland_surface(kip_window window);
-EGLContext kip_get_egl_context(kip_window window);
-EGLSurface kip_get_egl_surface(kip_window window);
-uint32_t kip_get_width(kip_window window);
-uint32_t kip_get_height(kip_window window);
-kip_fixed_point kip_pointer_get_x(kip_window window);
-kip_fixed_point kip_pointer_get_y(kip_window window);
-int32_t kip_fixed_point_to_int(kip_fixed_point fixedPoint);
-double kip_fixed_point_to_double(kip_fixed_point fixedPoint);
-void kip_poll_events(bool blocking);
-bool kip_is_key_down(kip_window window, kip_key key);
-bool kip_window_is_open(kip_window window);
-bool kip_frame_can_render(kip_window window);
-void kip_submit_frame(kip_window window);
-void kip_close_window(kip_window window);
-void kip_shutdown(void);
+KIPCORN_API void kip_init();
+KIPCORN_API void kip_init_headless();
+KIPCORN_API bool kip_is_headless();
+KIPCORN_API kip_window kip_create_window(uint32_t width, uint32_t height, const char* title, kip_graphics_backend graphicsBackend, bool vsync, bool windowDecorations, bool inputPassthrough, kip_egl_context shareContext);
+KIPCORN_API void kip_set_vsync(kip_window window, bool vsync);
+KIPCORN_API bool kip_get_vsync(kip_window window);
+#if KIPCORN_ENABLE_TEARING_CONTROL
+// Lets a window with vsync off be presented with tearing. Returns false if the compositor
+// has no tearing control, in which case frames stay on vblank.
+KIPCORN_API bool kip_set_allow_tearing(kip_window window, bool allowTearing);
+KIPCORN_API bool kip_get_allow_tearing(kip_window window);
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+KIPCORN_API bool kip_set_content_type(kip_window window, kip_content_type contentType);
+#endif
+#if KIPCORN_ENABLE_EGL
+KIPCORN_API void kip_make_egl_context_current(EGLContext context);
+KIPCORN_API void kip_make_egl_surface_current(kip_window window);
+#endif
+KIPCORN_API uint8_t* kip_get_pixels(kip_window window);
+// Copies the current frame as top-down ARGB8888, width * height * 4 bytes.
+// OpenGL windows must be read before kip_submit_frame.
+KIPCORN_API bool kip_read_pixels(kip_window window, uint8_t* destination);
+KIPCORN_API void kip_damage_region(kip_window window, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+KIPCORN_API struct wl_display* kip_get_wayland_display();
+KIPCORN_API struct wl_surface* kip_get_wayland_surface(kip_window window);
+#if KIPCORN_ENABLE_EGL
+KIPCORN_API EGLContext kip_get_egl_context(kip_window window);
+KIPCORN_API EGLSurface kip_get_egl_surface(kip_window window);
+#endif
+KIPCORN_API uint32_t kip_get_width(kip_window window);
+KIPCORN_API uint32_t kip_get_height(kip_window window);
+#if KIPCORN_ENABLE_POINTER
+KIPCORN_API kip_fixed_point kip_pointer_get_x(kip_window window);
+KIPCORN_API kip_fixed_point kip_pointer_get_y(kip_window window);
+#endif
+KIPCORN_API int32_t kip_fixed_point_to_int(kip_fixed_point fixedPoint);
+KIPCORN_API double kip_fixed_point_to_double(kip_fixed_point fixedPoint);
+KIPCORN_API void kip_poll_events(bool blocking);
+#if KIPCORN_ENABLE_KEYBOARD
+KIPCORN_API bool kip_is_key_down(kip_window window, kip_key key);
+#endif
+#if KIPCORN_ENABLE_XKB
+KIPCORN_API uint32_t kip_key_get_keysym(kip_key key);
+KIPCORN_API uint32_t kip_keyboard_get_modifiers();
+#endif
+KIPCORN_API bool kip_window_is_open(kip_window window);
+KIPCORN_API bool kip_frame_can_render(kip_window window);
+KIPCORN_API void kip_submit_frame(kip_window window);
+
+// With scheduling enabled on a vsync window, kip_frame_can_render and kip_wait_for_frame hold
+// rendering back until just before the predicted deadline. A margin of 0 uses 2ms. Render time
+// is measured from the last of those calls to kip_submit_frame.
+KIPCORN_API void kip_set_frame_scheduling(kip_window window, bool enabled, uint32_t safetyMarginMicroseconds);
+KIPCORN_API void kip_wait_for_frame(kip_window window);
+
+// Runs callback over the damaged part of a software window (or all of it if nothing
+// was damaged) in tiles spread over the render threads. Returns once every tile is done.
+KIPCORN_API void kip_render_tiles(kip_window window, kip_tile_callback callback, void* userData);
+KIPCORN_API void kip_set_tile_size(uint32_t width, uint32_t height);
+KIPCORN_API void kip_set_render_threads(uint32_t threadCount);
+
+#if KIPCORN_ENABLE_CLIPBOARD
+// Transfers copy between fds off the dispatch thread and report back from kip_poll_events.
+// kip_clipboard_set and kip_drag_start take ownership of fd, which must be seekable.
+KIPCORN_API bool kip_clipboard_set(const char* mimeType, int32_t fd, uint64_t size);
+KIPCORN_API bool kip_clipboard_set_data(const char* mimeType, const void* data, uint64_t size);
+KIPCORN_API bool kip_clipboard_has_mime_type(const char* mimeType);
+KIPCORN_API bool kip_clipboard_receive(const char* mimeType, int32_t fd, kip_transfer_callback callback, void* userData);
+KIPCORN_API bool kip_drag_start(kip_window window, const char* mimeType, int32_t fd, uint64_t size);
+// Dropped data arrives in a memfd rewound to the start; the callback owns it.
+KIPCORN_API void kip_set_drop_handler(const char* mimeType, kip_transfer_callback callback, void* userData);
+#endif
+KIPCORN_API void kip_close_window(kip_window window);
+KIPCORN_API void kip_shutdown(void);
+
+// Tracing is a no-op unless the library is built with KIPCORN_ENABLE_TRACING.
+// Event names are stored by pointer and must outlive the trace.
+KIPCORN_API void kip_trace_start(void);
+KIPCORN_API void kip_trace_stop(void);
+KIPCORN_API void kip_trace_begin(const char* name);
+KIPCORN_API void kip_trace_end(const char* name);
+KIPCORN_API void kip_trace_instant(const char* name);
+KIPCORN_API bool kip_trace_dump(const char* path);
 
 #ifdef __cplusplus
 }
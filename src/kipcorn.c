@@ -1,33 +1,102 @@
 #include <kipcorn/kipcorn.h>
-#include <EGL/egl.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/syscall.h>
+#if KIPCORN_ENABLE_CLIPBOARD
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#endif
+#if KIPCORN_ENABLE_THREADS
+#include <pthread.h>
+#endif
+#if KIPCORN_ENABLE_EGL
+#include <EGL/eglext.h>
+#endif
 #include <wayland-client-core.h>
 #include <wayland-client-protocol.h>
 #include <wayland-util.h>
-#include <xkbcommon/xkbcommon.h>
 
-#define KIPCORN_ENABLE_INPUT 1
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
 
+#define KIPCORN_GL_BGRA 0x80E1
+#define KIPCORN_GL_UNSIGNED_BYTE 0x1401
+
+#ifndef KIPCORN_ENABLE_TRACING
+#define KIPCORN_ENABLE_TRACING 0
+#endif
+
+#ifndef KIPCORN_TRACE_BUFFER_EVENTS
+#define KIPCORN_TRACE_BUFFER_EVENTS 65536
+#endif
+
+#if KIPCORN_ENABLE_TRACING
+#define KIP_TRACE_FUNCTION() const char* kipTraceScope __attribute__((cleanup(kip_trace_scope_end))) = kip_trace_scope_begin(__func__)
+#define KIP_TRACE_INSTANT(name) kip_trace_instant(name)
+#else
+#define KIP_TRACE_FUNCTION()
+#define KIP_TRACE_INSTANT(name)
+#endif
+
+void kip_resize(kip_window_data* windowData, uint32_t width, uint32_t height);
 void kip_frame_callback(void* data, struct wl_callback* callback, uint32_t callbackData);
 void kip_configure_xdg_surface(void* data, struct xdg_surface* surface, uint32_t serial);
 void kip_toplevel_configuration(void* data, struct xdg_toplevel* toplevel, int32_t width, int32_t height, struct wl_array* states);
 void kip_toplevel_close(void* data, struct xdg_toplevel* toplevel);
 void kip_toplevel_configure_bounds(void* data, struct xdg_toplevel* toplevel, int32_t width, int32_t height);
 void kip_toplevel_wm_capabilities(void* data, struct xdg_toplevel* toplevel, struct wl_array* states);
+#if KIPCORN_ENABLE_INPUT
 void kip_seat_capabilities(void* data, struct wl_seat* seat, uint32_t capabilities);
 void kip_seat_name(void* data, struct wl_seat* seat, const char* name);
+#endif
+#if KIPCORN_ENABLE_KEYBOARD
 void kip_keyboard_keymap(void* data, struct wl_keyboard* wl_keyboard, uint32_t format, int32_t fd, uint32_t size);
 void kip_keyboard_enter(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, struct wl_surface* surface, struct wl_array* keys);
 void kip_keyboard_leave(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, struct wl_surface* surface);
 void kip_keyboard_key(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state);
 void kip_keyboard_modifiers(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group);
 void kip_keyboard_repeat_info(void* data, struct wl_keyboard* wl_keyboard, int32_t rate, int32_t delay);
+#endif
+#if KIPCORN_ENABLE_POINTER
 void kip_pointer_enter(void *data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface, wl_fixed_t surface_x, wl_fixed_t surface_y);
 void kip_pointer_leave(void *data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface);
 void kip_pointer_motion(void *data, struct wl_pointer* wl_pointer, uint32_t time, wl_fixed_t surface_x, wl_fixed_t surface_y);
 void kip_pointer_button(void *data, struct wl_pointer* wl_pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state);
+void kip_pointer_axis(void *data, struct wl_pointer* wl_pointer, uint32_t time, uint32_t axis, wl_fixed_t value);
+void kip_pointer_frame(void *data, struct wl_pointer* wl_pointer);
+void kip_pointer_axis_source(void *data, struct wl_pointer* wl_pointer, uint32_t axis_source);
+void kip_pointer_axis_stop(void *data, struct wl_pointer* wl_pointer, uint32_t time, uint32_t axis);
+void kip_pointer_axis_discrete(void *data, struct wl_pointer* wl_pointer, uint32_t axis, int32_t discrete);
+#endif
+#if KIPCORN_ENABLE_CLIPBOARD
+void kip_data_device_data_offer(void* data, struct wl_data_device* wl_data_device, struct wl_data_offer* id);
+void kip_data_device_enter(void* data, struct wl_data_device* wl_data_device, uint32_t serial, struct wl_surface* surface, wl_fixed_t x, wl_fixed_t y, struct wl_data_offer* id);
+void kip_data_device_leave(void* data, struct wl_data_device* wl_data_device);
+void kip_data_device_motion(void* data, struct wl_data_device* wl_data_device, uint32_t time, wl_fixed_t x, wl_fixed_t y);
+void kip_data_device_drop(void* data, struct wl_data_device* wl_data_device);
+void kip_data_device_selection(void* data, struct wl_data_device* wl_data_device, struct wl_data_offer* id);
+void kip_data_offer_offer(void* data, struct wl_data_offer* wl_data_offer, const char* mime_type);
+void kip_data_offer_source_actions(void* data, struct wl_data_offer* wl_data_offer, uint32_t source_actions);
+void kip_data_offer_action(void* data, struct wl_data_offer* wl_data_offer, uint32_t dnd_action);
+void kip_data_source_target(void* data, struct wl_data_source* wl_data_source, const char* mime_type);
+void kip_data_source_send(void* data, struct wl_data_source* wl_data_source, const char* mime_type, int32_t fd);
+void kip_data_source_cancelled(void* data, struct wl_data_source* wl_data_source);
+void kip_data_source_dnd_drop_performed(void* data, struct wl_data_source* wl_data_source);
+void kip_data_source_dnd_finished(void* data, struct wl_data_source* wl_data_source);
+void kip_data_source_action(void* data, struct wl_data_source* wl_data_source, uint32_t dnd_action);
+void kip_transfer_dispatch_finished();
+void kip_clipboard_shutdown();
+#endif
 void kip_xdg_ping(void* data, struct xdg_wm_base* shell, uint32_t serial);
+#if KIPCORN_ENABLE_XKB
+void kip_keymap_install_compiled();
+void kip_keymap_cache_clear();
+#endif
 void kip_registry_global(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version);
 void kip_registry_global_remove(void* data, struct wl_registry* registry, uint32_t name);
 
@@ -41,40 +110,452 @@ struct wl_compositor* compositor;
 struct wl_display* display;
 struct wl_registry* registry;
 struct xdg_wm_base* shell;
+#if KIPCORN_ENABLE_DECORATIONS
 struct zxdg_decoration_manager_v1* decorationManager;
+#endif
+#if KIPCORN_ENABLE_TEARING_CONTROL
+struct wp_tearing_control_manager_v1* tearingControlManager;
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+struct wp_content_type_manager_v1* contentTypeManager;
+#endif
 
 struct wl_shm* sharedMemory;
 
+#if KIPCORN_ENABLE_INPUT
 struct wl_seat_listener seatListener = {kip_seat_capabilities, kip_seat_name};
-
-struct wl_keyboard_listener keyboardListener = {kip_keyboard_keymap, kip_keyboard_enter, kip_keyboard_leave, kip_keyboard_key, kip_keyboard_modifiers, kip_keyboard_repeat_info};
-
-struct wl_pointer_listener pointerListener = {kip_pointer_enter, kip_pointer_leave, kip_pointer_motion, kip_pointer_button};
-
-struct xkb_context* context;
 struct wl_seat* seat;
+#endif
 
+#if KIPCORN_ENABLE_KEYBOARD
+struct wl_keyboard_listener keyboardListener = {kip_keyboard_keymap, kip_keyboard_enter, kip_keyboard_leave, kip_keyboard_key, kip_keyboard_modifiers, kip_keyboard_repeat_info};
 struct wl_keyboard* keyboard;
-struct xkb_keymap* keymap;
-struct xkb_state* xkbState;
-
+#endif
+
+#if KIPCORN_ENABLE_XKB
+#define KIPCORN_KEYMAP_CACHE_SIZE 4
+#define KIPCORN_KEYCODE_COUNT 256
+
+typedef enum kip_modifier_index {
+    KIPCORN_MODIFIER_INDEX_SHIFT,
+    KIPCORN_MODIFIER_INDEX_CAPS_LOCK,
+    KIPCORN_MODIFIER_INDEX_CTRL,
+    KIPCORN_MODIFIER_INDEX_ALT,
+    KIPCORN_MODIFIER_INDEX_NUM_LOCK,
+    KIPCORN_MODIFIER_INDEX_LOGO,
+    KIPCORN_MODIFIER_INDEX_COUNT,
+} kip_modifier_index;
+
+#define KIPCORN_KEYMAP_LEVEL_MASKS 16
+
+typedef struct kip_keymap_level {
+    uint32_t keysym;
+    uint32_t capitalKeysym;
+} kip_keymap_level;
+
+// A key type picks its level from the modifiers it uses; a state matching no entry is level 0.
+typedef struct kip_keymap_entry {
+    uint32_t mask;
+    uint32_t level;
+} kip_keymap_entry;
+
+typedef struct kip_keymap_layout {
+    uint32_t typeMask;
+    uint32_t levelOffset;
+    uint32_t entryOffset;
+    uint16_t levelCount;
+    uint16_t entryCount;
+} kip_keymap_layout;
+
+typedef struct kip_keymap_key {
+    uint32_t layoutOffset;
+    uint32_t layoutCount;
+} kip_keymap_key;
+
+// A compiled keymap flattened into lookup tables, so key handling never calls into xkb.
+// The layout, level and entry tables live in the same allocation, right after the struct.
+typedef struct kip_keymap {
+    struct kip_keymap* next;
+    uint64_t hash;
+    uint32_t size;
+    uint32_t sequence;
+    uint32_t lastUsed;
+    uint32_t modifierMasks[KIPCORN_MODIFIER_INDEX_COUNT];
+    kip_keymap_key keys[KIPCORN_KEYCODE_COUNT];
+    kip_keymap_layout* layouts;
+    kip_keymap_level* levels;
+    kip_keymap_entry* entries;
+} kip_keymap;
+
+kip_keymap* keymapCache[KIPCORN_KEYMAP_CACHE_SIZE];
+kip_keymap* activeKeymap = NULL;
+uint32_t keymapSequence = 0;
+uint32_t keymapUseCounter = 0;
+uint32_t keyboardXkbModifiers = 0;
+uint32_t keyboardXkbGroup = 0;
+
+#if KIPCORN_ENABLE_THREADS
+typedef struct kip_keymap_job {
+    char* string;
+    uint64_t hash;
+    uint32_t size;
+    uint32_t sequence;
+} kip_keymap_job;
+
+kip_keymap* compiledKeymaps = NULL;
+bool keymapsCompiled = false;
+pthread_mutex_t keymapMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif
+
+#if KIPCORN_ENABLE_POINTER
+struct wl_pointer_listener pointerListener = {kip_pointer_enter, kip_pointer_leave, kip_pointer_motion, kip_pointer_button, kip_pointer_axis, kip_pointer_frame, kip_pointer_axis_source, kip_pointer_axis_stop, kip_pointer_axis_discrete};
 struct wl_pointer* pointer;
-
+#endif
+
+#if KIPCORN_ENABLE_CLIPBOARD
+#define KIPCORN_DATA_OFFER_MIME_TYPES 32
+#define KIPCORN_TRANSFER_CHUNK (1 << 20)
+
+typedef struct kip_data_offer {
+    struct wl_data_offer* offer;
+    uint32_t mimeTypeCount;
+    char* mimeTypes[KIPCORN_DATA_OFFER_MIME_TYPES];
+} kip_data_offer;
+
+typedef struct kip_data_source {
+    struct wl_data_source* source;
+    char* mimeType;
+    int32_t fd;
+    uint64_t size;
+} kip_data_source;
+
+// One fd-to-fd copy. It runs on its own thread and is handed back to kip_poll_events to
+// report completion, so callbacks always run on the dispatch thread.
+typedef struct kip_transfer {
+    struct kip_transfer* next;
+    int32_t from;
+    int32_t to;
+    int64_t offset;
+    uint64_t size;
+    uint64_t transferred;
+    bool success;
+
+    kip_window window;
+    char* mimeType;
+    int32_t callbackFd;
+    kip_data_offer* offer;
+    kip_transfer_callback callback;
+    void* userData;
+} kip_transfer;
+
+struct wl_data_device_listener dataDeviceListener = {kip_data_device_data_offer, kip_data_device_enter, kip_data_device_leave, kip_data_device_motion, kip_data_device_drop, kip_data_device_selection};
+struct wl_data_offer_listener dataOfferListener = {kip_data_offer_offer, kip_data_offer_source_actions, kip_data_offer_action};
+struct wl_data_source_listener dataSourceListener = {kip_data_source_target, kip_data_source_send, kip_data_source_cancelled, kip_data_source_dnd_drop_performed, kip_data_source_dnd_finished, kip_data_source_action};
+
+struct wl_data_device_manager* dataDeviceManager;
+struct wl_data_device* dataDevice;
+uint32_t inputSerial = 0;
+uint32_t pointerButtonSerial = 0;
+
+kip_data_offer* selectionOffer = NULL;
+kip_data_offer* dragOffer = NULL;
+kip_window dragWindow = KIPCORN_WINDOW_INVALID;
+uint32_t dragSerial = 0;
+bool dragAccepted = false;
+
+kip_data_source* selectionSource = NULL;
+kip_data_source* dragSource = NULL;
+
+char* dropMimeType = NULL;
+kip_transfer_callback dropCallback = NULL;
+void* dropUserData = NULL;
+
+kip_transfer* finishedTransfers = NULL;
+bool transfersFinished = false;
+pthread_mutex_t transferMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if KIPCORN_ENABLE_EGL
 EGLDisplay eglDisplay;
 EGLConfig eglConfig;
+bool eglInit = false;
+#endif
 
 bool kipcornInit = false;
-bool eglInit = false;
+bool headless = false;
 
 kip_window_data* kipcornWindows;
 uint32_t kipcornWindowCount = 0;
 uint32_t kipcornWindowCapacity = 0;
 
+#if KIPCORN_ENABLE_KEYBOARD
 kip_window keyboardFocusedKipcornWindow = KIPCORN_WINDOW_INVALID;
+#endif
+#if KIPCORN_ENABLE_POINTER
 kip_window pointerFocusedKipcornWindow = KIPCORN_WINDOW_INVALID;
+#endif
 
+#if KIPCORN_ENABLE_EGL
 EGLContext currentEglContext = NULL;
 EGLSurface currentEglSurface = NULL;
+#endif
+
+#define KIPCORN_TILE_SIZE_DEFAULT 64
+#define KIPCORN_FRAME_SCHEDULING_MARGIN_DEFAULT 2000
+#define KIPCORN_FRAME_INTERVAL_WINDOW 120
+#define KIPCORN_FRAME_INTERVAL_WARMUP 8
+
+uint32_t tileWidth = KIPCORN_TILE_SIZE_DEFAULT;
+uint32_t tileHeight = KIPCORN_TILE_SIZE_DEFAULT;
+
+typedef struct kip_tile_job {
+    kip_window window;
+    kip_tile_callback callback;
+    void* userData;
+    uint8_t* pixels;
+    uint32_t stride;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesPerRow;
+} kip_tile_job;
+
+kip_tile_job tileJob;
+
+#if KIPCORN_ENABLE_THREADS
+// Each worker owns a range of tile indices packed as begin | end << 32. The owner pops
+// from the front and idle workers steal the back half, both with a single CAS.
+typedef struct kip_tile_worker {
+    uint64_t range __attribute__((aligned(64)));
+    pthread_t thread;
+    uint32_t generation;
+} kip_tile_worker;
+
+kip_tile_worker* tileWorkers = NULL;
+uint32_t tileWorkerCount = 0;
+uint32_t tileWorkersRequested = 0;
+uint32_t tileWorkersResolved = 0;
+uint32_t tileWorkersFinished = 0;
+uint32_t tileGeneration = 0;
+bool tilePoolStopping = false;
+
+pthread_mutex_t tilePoolMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t tilePoolWake = PTHREAD_COND_INITIALIZER;
+pthread_cond_t tilePoolDone = PTHREAD_COND_INITIALIZER;
+#endif
+
+uint64_t kip_get_time() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+#if KIPCORN_ENABLE_TRACING
+typedef struct kip_trace_event {
+    const char* name;
+    uint64_t timestamp;
+    char phase;
+} kip_trace_event;
+
+typedef enum kip_trace_buffer_state {
+    KIPCORN_TRACE_BUFFER_LIVE,
+    KIPCORN_TRACE_BUFFER_EXITED,
+    KIPCORN_TRACE_BUFFER_FREE,
+} kip_trace_buffer_state;
+
+// Each thread appends to its own buffer, so recording never takes a lock.
+// Buffers are linked into traceBuffers once and never unlinked. When a thread exits its
+// buffer is kept until its events are dumped or stale, then handed to the next new thread.
+typedef struct kip_trace_buffer {
+    struct kip_trace_buffer* next;
+    uint32_t threadId;
+    uint32_t generation;
+    uint32_t count;
+    uint32_t state;
+    kip_trace_event events[KIPCORN_TRACE_BUFFER_EVENTS];
+} kip_trace_buffer;
+
+kip_trace_buffer* traceBuffers = NULL;
+uint32_t traceGeneration = 0;
+bool traceActive = false;
+
+__thread kip_trace_buffer* threadTraceBuffer = NULL;
+
+#if KIPCORN_ENABLE_THREADS
+pthread_key_t traceBufferKey;
+pthread_once_t traceBufferKeyOnce = PTHREAD_ONCE_INIT;
+
+void kip_trace_thread_exit(void* data) {
+    kip_trace_buffer* buffer = data;
+
+    bool stale = __atomic_load_n(&buffer->generation, __ATOMIC_ACQUIRE) != __atomic_load_n(&traceGeneration, __ATOMIC_ACQUIRE);
+    bool empty = !__atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&buffer->state, stale || empty ? KIPCORN_TRACE_BUFFER_FREE : KIPCORN_TRACE_BUFFER_EXITED, __ATOMIC_RELEASE);
+}
+
+void kip_trace_create_key() {
+    pthread_key_create(&traceBufferKey, kip_trace_thread_exit);
+}
+
+kip_trace_buffer* kip_trace_reuse_buffer(uint32_t generation) {
+    for (kip_trace_buffer* buffer = __atomic_load_n(&traceBuffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        uint32_t state = __atomic_load_n(&buffer->state, __ATOMIC_ACQUIRE);
+        if (state == KIPCORN_TRACE_BUFFER_LIVE) continue;
+        if (state == KIPCORN_TRACE_BUFFER_EXITED && __atomic_load_n(&buffer->generation, __ATOMIC_ACQUIRE) == generation) continue;
+
+        if (__atomic_compare_exchange_n(&buffer->state, &state, KIPCORN_TRACE_BUFFER_LIVE, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&buffer->count, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&buffer->generation, generation, __ATOMIC_RELEASE);
+            return buffer;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+kip_trace_buffer* kip_trace_thread_buffer() {
+    if (threadTraceBuffer) return threadTraceBuffer;
+
+    uint32_t generation = __atomic_load_n(&traceGeneration, __ATOMIC_ACQUIRE);
+    kip_trace_buffer* buffer = NULL;
+
+#if KIPCORN_ENABLE_THREADS
+    pthread_once(&traceBufferKeyOnce, kip_trace_create_key);
+    buffer = kip_trace_reuse_buffer(generation);
+#endif
+
+    if (!buffer) {
+        buffer = calloc(1, sizeof(kip_trace_buffer));
+        if (!buffer) return NULL;
+
+        buffer->generation = generation;
+        buffer->next = __atomic_load_n(&traceBuffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&traceBuffers, &buffer->next, buffer, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    buffer->threadId = (uint32_t)syscall(SYS_gettid);
+
+#if KIPCORN_ENABLE_THREADS
+    pthread_setspecific(traceBufferKey, buffer);
+#endif
+
+    threadTraceBuffer = buffer;
+    return buffer;
+}
+
+void kip_trace_record(const char* name, char phase) {
+    if (!__atomic_load_n(&traceActive, __ATOMIC_RELAXED)) return;
+
+    kip_trace_buffer* buffer = kip_trace_thread_buffer();
+    if (!buffer) return;
+
+    uint32_t generation = __atomic_load_n(&traceGeneration, __ATOMIC_ACQUIRE);
+    if (buffer->generation != generation) {
+        __atomic_store_n(&buffer->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&buffer->generation, generation, __ATOMIC_RELEASE);
+    }
+
+    uint32_t count = __atomic_load_n(&buffer->count, __ATOMIC_RELAXED);
+    if (count >= KIPCORN_TRACE_BUFFER_EVENTS) return;
+
+    buffer->events[count].name = name;
+    buffer->events[count].timestamp = kip_get_time();
+    buffer->events[count].phase = phase;
+    __atomic_store_n(&buffer->count, count + 1, __ATOMIC_RELEASE);
+}
+
+const char* kip_trace_scope_begin(const char* name) {
+    kip_trace_record(name, 'B');
+    return name;
+}
+
+void kip_trace_scope_end(const char** name) {
+    kip_trace_record(*name, 'E');
+}
+
+void kip_trace_write_string(FILE* file, const char* string) {
+    fputc('"', file);
+    for (; *string; string++) {
+        if (*string == '"' || *string == '\\') fputc('\\', file);
+        if ((unsigned char)*string < 0x20) continue;
+        fputc(*string, file);
+    }
+    fputc('"', file);
+}
+#endif
+
+void kip_trace_start(void) {
+#if KIPCORN_ENABLE_TRACING
+    __atomic_add_fetch(&traceGeneration, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&traceActive, true, __ATOMIC_RELEASE);
+#endif
+}
+
+void kip_trace_stop(void) {
+#if KIPCORN_ENABLE_TRACING
+    __atomic_store_n(&traceActive, false, __ATOMIC_RELEASE);
+#endif
+}
+
+void kip_trace_begin(const char* name) {
+#if KIPCORN_ENABLE_TRACING
+    kip_trace_record(name, 'B');
+#endif
+}
+
+void kip_trace_end(const char* name) {
+#if KIPCORN_ENABLE_TRACING
+    kip_trace_record(name, 'E');
+#endif
+}
+
+void kip_trace_instant(const char* name) {
+#if KIPCORN_ENABLE_TRACING
+    kip_trace_record(name, 'i');
+#endif
+}
+
+bool kip_trace_dump(const char* path) {
+#if KIPCORN_ENABLE_TRACING
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+
+    uint32_t generation = __atomic_load_n(&traceGeneration, __ATOMIC_ACQUIRE);
+    uint32_t processId = (uint32_t)getpid();
+    bool first = true;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+
+    for (kip_trace_buffer* buffer = __atomic_load_n(&traceBuffers, __ATOMIC_ACQUIRE); buffer; buffer = buffer->next) {
+        if (__atomic_load_n(&buffer->generation, __ATOMIC_ACQUIRE) != generation) continue;
+
+        uint32_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < count; i++) {
+            kip_trace_event* event = &buffer->events[i];
+
+            fputs(first ? "\n{\"name\":" : ",\n{\"name\":", file);
+            kip_trace_write_string(file, event->name ? event->name : "");
+            fprintf(file, ",\"cat\":\"kipcorn\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%u,\"tid\":%u%s}",
+                event->phase,
+                (unsigned long long)(event->timestamp / 1000), (unsigned long long)(event->timestamp % 1000),
+                processId, buffer->threadId,
+                event->phase == 'i' ? ",\"s\":\"t\"" : "");
+            first = false;
+        }
+
+        uint32_t exited = KIPCORN_TRACE_BUFFER_EXITED;
+        __atomic_compare_exchange_n(&buffer->state, &exited, KIPCORN_TRACE_BUFFER_FREE, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+
+    fputs("\n]}\n", file);
+    return fclose(file) == 0;
+#else
+    return false;
+#endif
+}
 
 void kip_add_callback_listener(kip_window window) {
     kip_window_data* windowData = &kipcornWindows[window];
@@ -85,18 +566,39 @@ void kip_add_callback_listener(kip_window window) {
 }
 
 void kip_init() {
-    kipcornInit = true;
     display = wl_display_connect(NULL);
+    if (!display) {
+        fprintf(stderr, "Failed to connect to Wayland display\n");
+        return;
+    }
+
+    kipcornInit = true;
+    headless = false;
     registry = wl_display_get_registry(display);
     wl_registry_add_listener(registry, &registryListener, NULL);
     wl_display_roundtrip(display);
 }
 
+void kip_init_headless() {
+    kipcornInit = true;
+    headless = true;
+    display = NULL;
+}
+
+bool kip_is_headless() {
+    return headless;
+}
+
+#if KIPCORN_ENABLE_EGL
 void kip_egl_init() {
     eglInit = true;
 
     eglBindAPI(EGL_OPENGL_API);
-    eglDisplay = eglGetDisplay((EGLNativeDisplayType)display);
+    if (headless) {
+        eglDisplay = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    } else {
+        eglDisplay = eglGetDisplay((EGLNativeDisplayType)display);
+    }
     eglInitialize(eglDisplay, NULL, NULL);
 
     EGLint attributes[] = {
@@ -106,18 +608,26 @@ void kip_egl_init() {
         EGL_ALPHA_SIZE, 8,
         EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
         EGL_DEPTH_SIZE, 24,
+        EGL_SURFACE_TYPE, headless ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT,
         EGL_NONE,
     };
 
     EGLint numConfigs;
     eglChooseConfig(eglDisplay, attributes, &eglConfig, 1, &numConfigs);
 }
+#endif
+
+kip_window kip_create_window(uint32_t width, uint32_t height, const char* title, kip_graphics_backend graphicsBackend, bool vsync, bool windowDecorations, bool inputPassthrough, kip_egl_context shareContext) {
+    KIP_TRACE_FUNCTION();
 
-kip_window kip_create_window(uint32_t width, uint32_t height, const char* title, kip_graphics_backend graphicsBackend, bool vsync, bool windowDecorations, bool inputPassthrough, EGLContext shareContext) {
     if (!kipcornInit) {
         return UINT32_MAX;
     }
 
+#if !KIPCORN_ENABLE_EGL
+    if (graphicsBackend == KIPCORN_GRAPHICS_BACKEND_OPENGL) return KIPCORN_WINDOW_INVALID;
+#endif
+
     kipcornWindowCount++;
 
     uint32_t oldKipcornWindowCapacity = kipcornWindowCapacity;
@@ -140,35 +650,60 @@ kip_window kip_create_window(uint32_t width, uint32_t height, const char* title,
     windowData->frameCanRender = true;
     windowData->vsync = vsync;
 
-    windowData->waylandSurface = wl_compositor_create_surface(compositor);
+    if (headless) {
+        if (graphicsBackend == KIPCORN_GRAPHICS_BACKEND_SOFTWARE) kip_resize(windowData, width, height);
+    } else {
+        windowData->waylandSurface = wl_compositor_create_surface(compositor);
 
-    windowData->xdgSurface = xdg_wm_base_get_xdg_surface(shell, windowData->waylandSurface);
+        windowData->xdgSurface = xdg_wm_base_get_xdg_surface(shell, windowData->waylandSurface);
 
-    xdg_surface_add_listener(windowData->xdgSurface, &xdgSurfaceListener, (void*)(uintptr_t)window);
-    windowData->toplevel = xdg_surface_get_toplevel(windowData->xdgSurface);
-    xdg_toplevel_add_listener(windowData->toplevel, &xdgToplevelListener, (void*)(uintptr_t)window);
-    xdg_toplevel_set_title(windowData->toplevel, title);
-    wl_surface_commit(windowData->waylandSurface);
+        xdg_surface_add_listener(windowData->xdgSurface, &xdgSurfaceListener, (void*)(uintptr_t)window);
+        windowData->toplevel = xdg_surface_get_toplevel(windowData->xdgSurface);
+        xdg_toplevel_add_listener(windowData->toplevel, &xdgToplevelListener, (void*)(uintptr_t)window);
+        xdg_toplevel_set_title(windowData->toplevel, title);
+        wl_surface_commit(windowData->waylandSurface);
 
-    kip_add_callback_listener(window);
+        kip_add_callback_listener(window);
 
-    if (windowData->decorationsEnabled) {
-        windowData->decorations = zxdg_decoration_manager_v1_get_toplevel_decoration(decorationManager, windowData->toplevel);
-        zxdg_toplevel_decoration_v1_set_mode(windowData->decorations, ZXDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
-    }
+#if KIPCORN_ENABLE_DECORATIONS
+        if (windowData->decorationsEnabled && decorationManager) {
+            windowData->decorations = zxdg_decoration_manager_v1_get_toplevel_decoration(decorationManager, windowData->toplevel);
+            zxdg_toplevel_decoration_v1_set_mode(windowData->decorations, ZXDG_TOPLEVEL_DECORATION_V1_MODE_SERVER_SIDE);
+        }
+#endif
 
-    if (inputPassthrough) wl_surface_set_input_region(windowData->waylandSurface, wl_compositor_create_region(compositor));
+#if KIPCORN_ENABLE_TEARING_CONTROL
+        if (tearingControlManager) windowData->tearingControl = wp_tearing_control_manager_v1_get_tearing_control(tearingControlManager, windowData->waylandSurface);
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+        if (contentTypeManager) windowData->contentType = wp_content_type_manager_v1_get_surface_content_type(contentTypeManager, windowData->waylandSurface);
+#endif
 
+        if (inputPassthrough) wl_surface_set_input_region(windowData->waylandSurface, wl_compositor_create_region(compositor));
+    }
+
+#if KIPCORN_ENABLE_EGL
     if (windowData->graphicsBackend == KIPCORN_GRAPHICS_BACKEND_OPENGL) {
         if (!eglInit) kip_egl_init();
 
-        windowData->eglWindow = wl_egl_window_create(windowData->waylandSurface, windowData->width, windowData->height);
-        if (!windowData->eglWindow) {
-            fprintf(stderr, "Failed to create EGL window: 0x%04x\n", eglGetError());
-            return KIPCORN_WINDOW_INVALID;
+        if (headless) {
+            EGLint pbufferAttributes[] = {
+                EGL_WIDTH, windowData->width,
+                EGL_HEIGHT, windowData->height,
+                EGL_NONE,
+            };
+
+            windowData->eglSurface = eglCreatePbufferSurface(eglDisplay, eglConfig, pbufferAttributes);
+        } else {
+            windowData->eglWindow = wl_egl_window_create(windowData->waylandSurface, windowData->width, windowData->height);
+            if (!windowData->eglWindow) {
+                fprintf(stderr, "Failed to create EGL window: 0x%04x\n", eglGetError());
+                return KIPCORN_WINDOW_INVALID;
+            }
+
+            windowData->eglSurface = eglCreatePlatformWindowSurface(eglDisplay, eglConfig, (EGLNativeWindowType)windowData->eglWindow, NULL);
         }
 
-        windowData->eglSurface = eglCreatePlatformWindowSurface(eglDisplay, eglConfig, (EGLNativeWindowType)windowData->eglWindow, NULL);
         if (windowData->eglSurface == EGL_NO_SURFACE) {
             fprintf(stderr, "Failed to create EGL surface: 0x%04x\n", eglGetError());
             return KIPCORN_WINDOW_INVALID;
@@ -184,12 +719,45 @@ kip_window kip_create_window(uint32_t width, uint32_t height, const char* title,
         eglMakeCurrent(eglDisplay, windowData->eglSurface, windowData->eglSurface, windowData->eglContext);
         eglSwapInterval(eglDisplay, vsync ? 1 : 0);
     }
+#endif
 
     windowData->open = true;
 
     return window;
 }
 
+#if KIPCORN_ENABLE_TEARING_CONTROL
+void kip_update_presentation_hint(kip_window_data* windowData) {
+    if (!windowData->tearingControl) return;
+
+    bool async = windowData->allowTearing && !windowData->vsync;
+    wp_tearing_control_v1_set_presentation_hint(windowData->tearingControl, async ? WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC : WP_TEARING_CONTROL_V1_PRESENTATION_HINT_VSYNC);
+}
+
+bool kip_set_allow_tearing(kip_window window, bool allowTearing) {
+    kip_window_data* windowData = &kipcornWindows[window];
+
+    windowData->allowTearing = allowTearing;
+    kip_update_presentation_hint(windowData);
+
+    return windowData->tearingControl;
+}
+
+bool kip_get_allow_tearing(kip_window window) {
+    return kipcornWindows[window].allowTearing;
+}
+#endif
+
+#if KIPCORN_ENABLE_CONTENT_TYPE
+bool kip_set_content_type(kip_window window, kip_content_type contentType) {
+    kip_window_data* windowData = &kipcornWindows[window];
+    if (!windowData->contentType) return false;
+
+    wp_content_type_v1_set_content_type(windowData->contentType, contentType);
+    return true;
+}
+#endif
+
 void kip_set_vsync(kip_window window, bool vsync) {
     kip_window_data* windowData = &kipcornWindows[window];
 
@@ -198,11 +766,13 @@ void kip_set_vsync(kip_window window, bool vsync) {
             windowData->vsync = vsync;
             break;
         }
+#if KIPCORN_ENABLE_EGL
         case KIPCORN_GRAPHICS_BACKEND_OPENGL: {
             eglSwapInterval(eglDisplay, vsync ? 1 : 0);
             windowData->vsync = vsync;
             break;
         }
+#endif
         case KIPCORN_GRAPHICS_BACKEND_VULKAN: {
             break;
         }
@@ -211,12 +781,17 @@ void kip_set_vsync(kip_window window, bool vsync) {
             break;
         }
     }
+
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    kip_update_presentation_hint(windowData);
+#endif
 }
 
 bool kip_get_vsync(kip_window window) {
     return kipcornWindows[window].vsync;
 }
 
+#if KIPCORN_ENABLE_EGL
 void kip_make_egl_context_current(EGLContext context) {
     if (currentEglContext == context) return;
     currentEglContext = context;
@@ -232,11 +807,82 @@ void kip_make_egl_surface_current(kip_window window) {
     currentEglSurface = windowData->eglSurface;
     eglMakeCurrent(eglDisplay, currentEglSurface, currentEglSurface, windowData->eglContext);
 }
+#endif
 
 uint8_t* kip_get_pixels(kip_window window) {
     return kipcornWindows[window].pixels;
 }
 
+bool kip_read_pixels(kip_window window, uint8_t* destination) {
+    KIP_TRACE_FUNCTION();
+
+    kip_window_data* windowData = &kipcornWindows[window];
+    uint32_t stride = windowData->width * 4;
+
+    switch (windowData->graphicsBackend) {
+        case KIPCORN_GRAPHICS_BACKEND_SOFTWARE: {
+            if (!windowData->pixels) return false;
+
+            memcpy(destination, windowData->pixels, stride * windowData->height);
+            return true;
+        }
+
+#if KIPCORN_ENABLE_EGL
+        case KIPCORN_GRAPHICS_BACKEND_OPENGL: {
+            static void (*readPixels)(int32_t, int32_t, int32_t, int32_t, uint32_t, uint32_t, void*) = NULL;
+            if (!readPixels) readPixels = (void (*)(int32_t, int32_t, int32_t, int32_t, uint32_t, uint32_t, void*))eglGetProcAddress("glReadPixels");
+            if (!readPixels) return false;
+
+            kip_make_egl_surface_current(window);
+            readPixels(0, 0, windowData->width, windowData->height, KIPCORN_GL_BGRA, KIPCORN_GL_UNSIGNED_BYTE, destination);
+
+            uint8_t* row = malloc(stride);
+            if (!row) return false;
+
+            for (uint32_t top = 0, bottom = windowData->height - 1; top < bottom; top++, bottom--) {
+                memcpy(row, destination + top * stride, stride);
+                memcpy(destination + top * stride, destination + bottom * stride, stride);
+                memcpy(destination + bottom * stride, row, stride);
+            }
+
+            free(row);
+            return true;
+        }
+#endif
+
+        default: {
+            return false;
+        }
+    }
+}
+
+void kip_damage_region(kip_window window, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    kip_window_data* windowData = &kipcornWindows[window];
+
+    if (x >= windowData->width || y >= windowData->height || !width || !height) return;
+    if (width > windowData->width - x) width = windowData->width - x;
+    if (height > windowData->height - y) height = windowData->height - y;
+
+    if (windowData->damaged) {
+        uint32_t right = windowData->damageX + windowData->damageWidth;
+        uint32_t bottom = windowData->damageY + windowData->damageHeight;
+
+        if (x + width > right) right = x + width;
+        if (y + height > bottom) bottom = y + height;
+        if (windowData->damageX < x) x = windowData->damageX;
+        if (windowData->damageY < y) y = windowData->damageY;
+
+        width = right - x;
+        height = bottom - y;
+    }
+
+    windowData->damageX = x;
+    windowData->damageY = y;
+    windowData->damageWidth = width;
+    windowData->damageHeight = height;
+    windowData->damaged = true;
+}
+
 struct wl_display* kip_get_wayland_display() {
     return display;
 }
@@ -245,6 +891,7 @@ struct wl_surface* kip_get_wayland_surface(kip_window window) {
     return kipcornWindows[window].waylandSurface;
 }
 
+#if KIPCORN_ENABLE_EGL
 EGLContext kip_get_egl_context(kip_window window) {
     return kipcornWindows[window].eglContext;
 }
@@ -252,6 +899,7 @@ EGLContext kip_get_egl_context(kip_window window) {
 EGLSurface kip_get_egl_surface(kip_window window) {
     return kipcornWindows[window].eglSurface;
 }
+#endif
 
 uint32_t kip_get_width(kip_window window) {
     return kipcornWindows[window].width;
@@ -261,6 +909,7 @@ uint32_t kip_get_height(kip_window window) {
     return kipcornWindows[window].height;
 }
 
+#if KIPCORN_ENABLE_POINTER
 kip_fixed_point kip_pointer_get_x(kip_window window) {
     return kipcornWindows[window].pointerX;
 }
@@ -268,6 +917,7 @@ kip_fixed_point kip_pointer_get_x(kip_window window) {
 kip_fixed_point kip_pointer_get_y(kip_window window) {
     return kipcornWindows[window].pointerY;
 }
+#endif
 
 int32_t kip_fixed_point_to_int(kip_fixed_point fixedPoint) {
     return wl_fixed_to_int(fixedPoint);
@@ -278,6 +928,18 @@ double kip_fixed_point_to_double(kip_fixed_point fixedPoint) {
 }
 
 void kip_poll_events(bool blocking) {
+    KIP_TRACE_FUNCTION();
+
+    if (headless) return;
+
+#if KIPCORN_ENABLE_XKB
+    kip_keymap_install_compiled();
+#endif
+
+#if KIPCORN_ENABLE_CLIPBOARD
+    kip_transfer_dispatch_finished();
+#endif
+
     if (blocking) {
         wl_display_dispatch(display);
         return;
@@ -303,15 +965,19 @@ void kip_poll_events(bool blocking) {
     }
 }
 
+#if KIPCORN_ENABLE_KEYBOARD
 bool kip_is_key_down(kip_window window, kip_key key) {
     return key < 139 && kipcornWindows[window].keyStates[key];
 }
+#endif
 
 bool kip_window_is_open(kip_window window) {
     return kipcornWindows[window].open;
 }
 
 void kip_display_frame(kip_window_data* windowData) {
+    KIP_TRACE_FUNCTION();
+
     switch (windowData->graphicsBackend) {
         case KIPCORN_GRAPHICS_BACKEND_NONE: {
             break;
@@ -320,16 +986,27 @@ void kip_display_frame(kip_window_data* windowData) {
         case KIPCORN_GRAPHICS_BACKEND_SOFTWARE: {
             if (!windowData->pixels) return;
 
-            wl_surface_attach(windowData->waylandSurface, windowData->buffer, 0, 0);
-            wl_surface_damage(windowData->waylandSurface, 0, 0, windowData->width, windowData->height);
-            wl_surface_commit(windowData->waylandSurface);
+            // Headless frames are never committed, but they still consume the damage region.
+            if (!headless) {
+                wl_surface_attach(windowData->waylandSurface, windowData->buffer, 0, 0);
+                if (windowData->damaged) {
+                    wl_surface_damage(windowData->waylandSurface, windowData->damageX, windowData->damageY, windowData->damageWidth, windowData->damageHeight);
+                } else {
+                    wl_surface_damage(windowData->waylandSurface, 0, 0, windowData->width, windowData->height);
+                }
+                wl_surface_commit(windowData->waylandSurface);
+            }
+
+            windowData->damaged = false;
             break;
         }
     
+#if KIPCORN_ENABLE_EGL
         case KIPCORN_GRAPHICS_BACKEND_OPENGL: {
             eglSwapBuffers(eglDisplay, windowData->eglSurface);
             break;
         }
+#endif
 
         case KIPCORN_GRAPHICS_BACKEND_VULKAN: {
             break;
@@ -341,34 +1018,343 @@ void kip_display_frame(kip_window_data* windowData) {
     }
 }
 
+// Latest point after the frame callback at which rendering can start and still be
+// committed before the compositor's next repaint.
+uint64_t kip_frame_start_time(kip_window_data* windowData) {
+    if (!windowData->frameScheduling || !windowData->vsync || headless || !windowData->refreshInterval) return 0;
+
+    uint64_t budget = windowData->renderDuration + windowData->frameSchedulingMargin;
+    if (budget >= windowData->refreshInterval) return 0;
+
+    return windowData->frameCallbackTime + windowData->refreshInterval - budget;
+}
+
 bool kip_frame_can_render(kip_window window) {
-    return kipcornWindows[window].frameCanRender;
+    kip_window_data* windowData = &kipcornWindows[window];
+    if (!windowData->frameCanRender) return false;
+
+    uint64_t now = kip_get_time();
+    if (now < kip_frame_start_time(windowData)) return false;
+
+    // Apps may poll without rendering, so the latest check before kip_submit_frame starts the render.
+    windowData->renderStartTime = now;
+    return true;
+}
+
+void kip_wait_for_frame(kip_window window) {
+    KIP_TRACE_FUNCTION();
+
+    kip_window_data* windowData = &kipcornWindows[window];
+
+    while (windowData->open && !windowData->frameCanRender) {
+        kip_poll_events(true);
+        windowData = &kipcornWindows[window];
+    }
+
+    uint64_t startTime = kip_frame_start_time(windowData);
+    if (startTime > kip_get_time()) {
+        struct timespec time = {
+            .tv_sec = startTime / 1000000000,
+            .tv_nsec = startTime % 1000000000,
+        };
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR);
+        kip_poll_events(false);
+        windowData = &kipcornWindows[window];
+    }
+
+    windowData->renderStartTime = kip_get_time();
+}
+
+void kip_set_frame_scheduling(kip_window window, bool enabled, uint32_t safetyMarginMicroseconds) {
+    kip_window_data* windowData = &kipcornWindows[window];
+
+    windowData->frameScheduling = enabled;
+    windowData->frameSchedulingMargin = (uint64_t)(safetyMarginMicroseconds ? safetyMarginMicroseconds : KIPCORN_FRAME_SCHEDULING_MARGIN_DEFAULT) * 1000;
 }
 
 void kip_submit_frame(kip_window window) {
+    KIP_TRACE_FUNCTION();
+
     kip_window_data* windowData = &kipcornWindows[window];
     if (!windowData) return;
 
-    if (windowData->vsync) {
-        if (!windowData->frameCanRender) return;
+    if (windowData->vsync && !headless) {
+        if (!windowData->frameCanRender) {
+            KIP_TRACE_INSTANT("kip_submit_frame skipped");
+            return;
+        }
 
         windowData->frameCanRender = false;
     }
 
     kip_display_frame(windowData);
+
+    if (windowData->renderStartTime) {
+        uint64_t duration = kip_get_time() - windowData->renderStartTime;
+
+        // Anything longer than a refresh disables scheduling already, and an uncapped idle gap
+        // would keep it disabled until the slow decay caught up.
+        if (windowData->refreshInterval && duration > windowData->refreshInterval) duration = windowData->refreshInterval;
+
+        // Rise quickly and decay slowly so one slow frame is not followed by a missed one.
+        if (duration > windowData->renderDuration) {
+            windowData->renderDuration += (duration - windowData->renderDuration) / 2;
+        } else {
+            windowData->renderDuration -= (windowData->renderDuration - duration) / 16;
+        }
+
+        windowData->renderStartTime = 0;
+    }
 }
 
 void kip_frame_callback(void* data, struct wl_callback* callback, uint32_t callbackData) {
+    KIP_TRACE_FUNCTION();
+
     kip_window_data* windowData = &kipcornWindows[(kip_window)(uintptr_t)data];
     if (!windowData) return;
 
     windowData->frameCallbackPending = false;
     windowData->frameCanRender = true;
+    windowData->frameCallbackTime = kip_get_time();
+
+    // The intervals are shaped by the scheduler itself: with an estimate of two refreshes it starts
+    // rendering too late for the next one, and the resulting two-refresh interval confirms the
+    // estimate. So each interval is divided by the number of refreshes it spans, counted against the
+    // shortest recent interval, and a shorter estimate is taken at once, since starting early only
+    // costs latency while starting late costs a refresh. Scheduling waits for a few unscheduled
+    // callbacks so that the shortest interval is not the scheduler's own doing.
+    uint64_t interval = (uint64_t)(callbackData - windowData->frameCallbackTimestamp) * 1000000;
+    if (windowData->frameCallbackTimestamp && interval) {
+        if (!windowData->shortestFrameInterval || interval < windowData->shortestFrameInterval) windowData->shortestFrameInterval = interval;
+        if (!windowData->nextShortestFrameInterval || interval < windowData->nextShortestFrameInterval) windowData->nextShortestFrameInterval = interval;
+
+        // A longer shortest interval is only accepted while it is below 1.5 refreshes; a multiple
+        // of the refresh cannot be told apart from frames that missed one.
+        if (++windowData->frameIntervalSamples == KIPCORN_FRAME_INTERVAL_WINDOW) {
+            if (windowData->nextShortestFrameInterval < windowData->shortestFrameInterval * 3 / 2) windowData->shortestFrameInterval = windowData->nextShortestFrameInterval;
+            windowData->nextShortestFrameInterval = 0;
+            windowData->frameIntervalSamples = 0;
+        }
+
+        // Callbacks only arrive for submitted frames, and gaps over a few refreshes are idle time
+        // that millisecond timestamps cannot split precisely.
+        uint64_t refreshes = (interval + windowData->shortestFrameInterval / 2) / windowData->shortestFrameInterval;
+        if (refreshes <= 4 && (windowData->refreshInterval || windowData->frameIntervalSamples >= KIPCORN_FRAME_INTERVAL_WARMUP)) {
+            interval /= refreshes;
+
+            if (!windowData->refreshInterval || interval < windowData->refreshInterval) {
+                windowData->refreshInterval = interval;
+            } else {
+                windowData->refreshInterval = (windowData->refreshInterval * 7 + interval) / 8;
+            }
+        }
+    }
+    windowData->frameCallbackTimestamp = callbackData;
 
     wl_callback_destroy(callback);
     kip_add_callback_listener((kip_window)(uintptr_t)data);
 }
 
+void kip_render_tile(uint32_t tile) {
+    uint32_t x = tileJob.x + (tile % tileJob.tilesPerRow) * tileWidth;
+    uint32_t y = tileJob.y + (tile / tileJob.tilesPerRow) * tileHeight;
+    uint32_t width = tileJob.x + tileJob.width - x;
+    uint32_t height = tileJob.y + tileJob.height - y;
+
+    if (width > tileWidth) width = tileWidth;
+    if (height > tileHeight) height = tileHeight;
+
+    tileJob.callback(tileJob.window, tileJob.pixels + y * tileJob.stride + x * 4, tileJob.stride, x, y, width, height, tileJob.userData);
+}
+
+#if KIPCORN_ENABLE_THREADS
+bool kip_tile_pop(kip_tile_worker* worker, uint32_t* tile) {
+    uint64_t range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        if (begin >= end) return false;
+
+        if (__atomic_compare_exchange_n(&worker->range, &range, (uint64_t)(begin + 1) | (uint64_t)end << 32, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *tile = begin;
+            return true;
+        }
+    }
+}
+
+bool kip_tile_steal(uint32_t thief) {
+    for (uint32_t i = 1; i < tileWorkerCount; i++) {
+        kip_tile_worker* victim = &tileWorkers[(thief + i) % tileWorkerCount];
+        uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+
+        for (;;) {
+            uint32_t begin = (uint32_t)range;
+            uint32_t end = (uint32_t)(range >> 32);
+            if (begin >= end) break;
+
+            uint32_t split = end - (end - begin + 1) / 2;
+            if (__atomic_compare_exchange_n(&victim->range, &range, (uint64_t)begin | (uint64_t)split << 32, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&tileWorkers[thief].range, (uint64_t)split | (uint64_t)end << 32, __ATOMIC_RELEASE);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void kip_tile_work(uint32_t worker) {
+    KIP_TRACE_FUNCTION();
+
+    uint32_t tile;
+    do {
+        while (kip_tile_pop(&tileWorkers[worker], &tile)) kip_render_tile(tile);
+    } while (kip_tile_steal(worker));
+}
+
+void* kip_tile_thread(void* data) {
+    uint32_t worker = (uint32_t)(uintptr_t)data;
+
+    pthread_mutex_lock(&tilePoolMutex);
+    for (;;) {
+        while (!tilePoolStopping && tileWorkers[worker].generation == tileGeneration) {
+            pthread_cond_wait(&tilePoolWake, &tilePoolMutex);
+        }
+
+        if (tilePoolStopping) break;
+        tileWorkers[worker].generation = tileGeneration;
+        pthread_mutex_unlock(&tilePoolMutex);
+
+        kip_tile_work(worker);
+
+        pthread_mutex_lock(&tilePoolMutex);
+        if (++tileWorkersFinished == tileWorkerCount - 1) pthread_cond_signal(&tilePoolDone);
+    }
+    pthread_mutex_unlock(&tilePoolMutex);
+
+    return NULL;
+}
+
+void kip_tile_pool_stop() {
+    if (!tileWorkers) return;
+
+    pthread_mutex_lock(&tilePoolMutex);
+    tilePoolStopping = true;
+    pthread_cond_broadcast(&tilePoolWake);
+    pthread_mutex_unlock(&tilePoolMutex);
+
+    for (uint32_t i = 1; i < tileWorkerCount; i++) {
+        pthread_join(tileWorkers[i].thread, NULL);
+    }
+
+    free(tileWorkers);
+    tileWorkers = NULL;
+    tileWorkerCount = 0;
+    tileWorkersResolved = 0;
+    tilePoolStopping = false;
+}
+
+void kip_tile_pool_start() {
+    uint32_t workerCount = tileWorkersRequested;
+    if (!workerCount) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        workerCount = processors > 0 ? (uint32_t)processors : 1;
+    }
+
+    // Compared against the count asked for rather than started, so a pool that came up short
+    // is kept instead of being torn down and respawned on every call.
+    if (tileWorkers && tileWorkersResolved == workerCount) return;
+    kip_tile_pool_stop();
+
+    void* workers;
+    if (posix_memalign(&workers, 64, workerCount * sizeof(kip_tile_worker))) return;
+
+    tileWorkers = workers;
+    memset(tileWorkers, 0, workerCount * sizeof(kip_tile_worker));
+    tileWorkerCount = 1;
+    tileWorkersResolved = workerCount;
+
+    for (uint32_t i = 1; i < workerCount; i++) {
+        tileWorkers[i].generation = tileGeneration;
+        if (pthread_create(&tileWorkers[i].thread, NULL, kip_tile_thread, (void*)(uintptr_t)i)) break;
+        tileWorkerCount++;
+    }
+}
+#endif
+
+void kip_render_tiles(kip_window window, kip_tile_callback callback, void* userData) {
+    KIP_TRACE_FUNCTION();
+
+    kip_window_data* windowData = &kipcornWindows[window];
+    if (windowData->graphicsBackend != KIPCORN_GRAPHICS_BACKEND_SOFTWARE || !windowData->pixels) return;
+
+    tileJob.window = window;
+    tileJob.callback = callback;
+    tileJob.userData = userData;
+    tileJob.pixels = windowData->pixels;
+    tileJob.stride = windowData->width * 4;
+
+    if (windowData->damaged) {
+        tileJob.x = windowData->damageX;
+        tileJob.y = windowData->damageY;
+        tileJob.width = windowData->damageWidth;
+        tileJob.height = windowData->damageHeight;
+    } else {
+        tileJob.x = 0;
+        tileJob.y = 0;
+        tileJob.width = windowData->width;
+        tileJob.height = windowData->height;
+    }
+
+    tileJob.tilesPerRow = (tileJob.width + tileWidth - 1) / tileWidth;
+    uint32_t tileCount = tileJob.tilesPerRow * ((tileJob.height + tileHeight - 1) / tileHeight);
+    if (!tileCount) return;
+
+#if KIPCORN_ENABLE_THREADS
+    kip_tile_pool_start();
+
+    if (tileWorkers && tileWorkerCount > 1 && tileCount > 1) {
+        for (uint32_t i = 0; i < tileWorkerCount; i++) {
+            uint64_t begin = (uint64_t)tileCount * i / tileWorkerCount;
+            uint64_t end = (uint64_t)tileCount * (i + 1) / tileWorkerCount;
+            __atomic_store_n(&tileWorkers[i].range, begin | end << 32, __ATOMIC_RELAXED);
+        }
+
+        pthread_mutex_lock(&tilePoolMutex);
+        tileWorkersFinished = 0;
+        tileGeneration++;
+        pthread_cond_broadcast(&tilePoolWake);
+        pthread_mutex_unlock(&tilePoolMutex);
+
+        kip_tile_work(0);
+
+        pthread_mutex_lock(&tilePoolMutex);
+        while (tileWorkersFinished < tileWorkerCount - 1) {
+            pthread_cond_wait(&tilePoolDone, &tilePoolMutex);
+        }
+        pthread_mutex_unlock(&tilePoolMutex);
+        return;
+    }
+#endif
+
+    for (uint32_t tile = 0; tile < tileCount; tile++) {
+        kip_render_tile(tile);
+    }
+}
+
+void kip_set_tile_size(uint32_t width, uint32_t height) {
+    tileWidth = width ? width : KIPCORN_TILE_SIZE_DEFAULT;
+    tileHeight = height ? height : KIPCORN_TILE_SIZE_DEFAULT;
+}
+
+void kip_set_render_threads(uint32_t threadCount) {
+#if KIPCORN_ENABLE_THREADS
+    tileWorkersRequested = threadCount;
+#endif
+}
+
 void kip_close_window(kip_window window) {
     kip_window_data* windowData = &kipcornWindows[window];
     if (!windowData) return;
@@ -380,14 +1366,17 @@ void kip_close_window(kip_window window) {
 
         case KIPCORN_GRAPHICS_BACKEND_SOFTWARE: {
             if (windowData->buffer) wl_buffer_destroy(windowData->buffer);
+            if (windowData->pixels) munmap(windowData->pixels, windowData->width * windowData->height * 4);
             break;
         }
 
+#if KIPCORN_ENABLE_EGL
         case KIPCORN_GRAPHICS_BACKEND_OPENGL: {
-            wl_egl_window_destroy(windowData->eglWindow);
+            if (windowData->eglWindow) wl_egl_window_destroy(windowData->eglWindow);
             eglDestroySurface(eglDisplay, windowData->eglSurface);
             break;
         }
+#endif
 
         case KIPCORN_GRAPHICS_BACKEND_VULKAN: {
             break;
@@ -398,16 +1387,33 @@ void kip_close_window(kip_window window) {
         }
     }
 
-    if (windowData->decorationsEnabled) {
+#if KIPCORN_ENABLE_DECORATIONS
+    if (windowData->decorations) {
         zxdg_toplevel_decoration_v1_destroy(windowData->decorations);
         windowData->decorations = NULL;
     }
+#endif
+
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    if (windowData->tearingControl) {
+        wp_tearing_control_v1_destroy(windowData->tearingControl);
+        windowData->tearingControl = NULL;
+    }
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+    if (windowData->contentType) {
+        wp_content_type_v1_destroy(windowData->contentType);
+        windowData->contentType = NULL;
+    }
+#endif
 
-    xdg_toplevel_destroy(windowData->toplevel);
-    xdg_surface_destroy(windowData->xdgSurface);
+    if (!headless) {
+        xdg_toplevel_destroy(windowData->toplevel);
+        xdg_surface_destroy(windowData->xdgSurface);
 
-    if (windowData->frameCallbackPending) wl_callback_destroy(windowData->callback);
-    wl_surface_destroy(windowData->waylandSurface);
+        if (windowData->frameCallbackPending) wl_callback_destroy(windowData->callback);
+        wl_surface_destroy(windowData->waylandSurface);
+    }
 
     memset(windowData, 0, sizeof(kip_window_data));
 }
@@ -415,54 +1421,101 @@ void kip_close_window(kip_window window) {
 void kip_shutdown(void) {
     kipcornInit = false;
 
-    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#if KIPCORN_ENABLE_EGL
+    if (eglInit) eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
 
     for (uint32_t i = 0; i < kipcornWindowCount; i++) {
+#if KIPCORN_ENABLE_EGL
         if (kipcornWindows[i].graphicsBackend == KIPCORN_GRAPHICS_BACKEND_OPENGL) {
             eglDestroyContext(eglDisplay, kipcornWindows[i].eglContext);
         }
+#endif
 
-        if (kipcornWindows[i].waylandSurface == 0) continue;
+        if (!kipcornWindows[i].open && kipcornWindows[i].waylandSurface == 0) continue;
 
         kip_close_window(i);
     }
 
-    eglTerminate(eglDisplay);
-
-    zxdg_decoration_manager_v1_destroy(decorationManager);
-
-    wl_keyboard_release(keyboard);
-    wl_seat_release(seat);
-
-    xkb_state_unref(xkbState);
-    xkb_keymap_unref(keymap);
-    xkb_context_unref(context);
+#if KIPCORN_ENABLE_THREADS
+    kip_tile_pool_stop();
+#endif
+
+#if KIPCORN_ENABLE_EGL
+    if (eglInit) eglTerminate(eglDisplay);
+    eglInit = false;
+#endif
+
+#if KIPCORN_ENABLE_DECORATIONS
+    if (decorationManager) zxdg_decoration_manager_v1_destroy(decorationManager);
+#endif
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    if (tearingControlManager) wp_tearing_control_manager_v1_destroy(tearingControlManager);
+    tearingControlManager = NULL;
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+    if (contentTypeManager) wp_content_type_manager_v1_destroy(contentTypeManager);
+    contentTypeManager = NULL;
+#endif
+
+#if KIPCORN_ENABLE_CLIPBOARD
+    kip_clipboard_shutdown();
+#endif
+
+#if KIPCORN_ENABLE_KEYBOARD
+    if (keyboard && wl_keyboard_get_version(keyboard) >= 3) wl_keyboard_release(keyboard);
+    else if (keyboard) wl_keyboard_destroy(keyboard);
+    keyboard = NULL;
+#endif
+#if KIPCORN_ENABLE_POINTER
+    if (pointer && wl_pointer_get_version(pointer) >= 3) wl_pointer_release(pointer);
+    else if (pointer) wl_pointer_destroy(pointer);
+    pointer = NULL;
+#endif
+#if KIPCORN_ENABLE_INPUT
+    if (seat && wl_seat_get_version(seat) >= 5) wl_seat_release(seat);
+    else if (seat) wl_seat_destroy(seat);
+    seat = NULL;
+#endif
+
+#if KIPCORN_ENABLE_XKB
+    kip_keymap_cache_clear();
+#endif
+
+    if (!headless) {
+        wl_registry_destroy(registry);
+        wl_display_disconnect(display);
+    }
 
-    wl_registry_destroy(registry);
-    wl_display_disconnect(display);
     free(kipcornWindows);
 }
 
 void kip_resize(kip_window_data* windowData, uint32_t width, uint32_t height) {
+    KIP_TRACE_FUNCTION();
+
     switch (windowData->graphicsBackend) {
         case KIPCORN_GRAPHICS_BACKEND_SOFTWARE: {
             if (windowData->pixels) munmap(windowData->pixels, windowData->width * windowData->height * 4);
 
             windowData->width = width;
             windowData->height = height;
+            windowData->damaged = false;
 
             int32_t fileDescriptor = memfd_create("", MFD_CLOEXEC);
             ftruncate(fileDescriptor, width*  height*  4);
             
             windowData->pixels = mmap(NULL, width*  height*  4, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
 
-            struct wl_shm_pool* pool = wl_shm_create_pool(sharedMemory, fileDescriptor, width*  height*  4);
-            windowData->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, width*  4, WL_SHM_FORMAT_ARGB8888);
-            wl_shm_pool_destroy(pool);
+            if (!headless) {
+                struct wl_shm_pool* pool = wl_shm_create_pool(sharedMemory, fileDescriptor, width*  height*  4);
+                windowData->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, width*  4, WL_SHM_FORMAT_ARGB8888);
+                wl_shm_pool_destroy(pool);
+            }
             close(fileDescriptor);
             break;
         }
 
+#if KIPCORN_ENABLE_EGL
         case KIPCORN_GRAPHICS_BACKEND_OPENGL: {
             windowData->width = width;
             windowData->height = height;
@@ -470,6 +1523,7 @@ void kip_resize(kip_window_data* windowData, uint32_t width, uint32_t height) {
             wl_egl_window_resize(windowData->eglWindow, windowData->width, windowData->height, 0, 0);
             break;
         }
+#endif
 
         case KIPCORN_GRAPHICS_BACKEND_VULKAN: {
             break;
@@ -482,6 +1536,8 @@ void kip_resize(kip_window_data* windowData, uint32_t width, uint32_t height) {
 }
 
 void kip_configure_xdg_surface(void* data, struct xdg_surface* surface, uint32_t serial) {
+    KIP_TRACE_FUNCTION();
+
     kip_window_data* windowData = &kipcornWindows[(kip_window)(uintptr_t)data];
     if (!windowData) return;
 
@@ -494,6 +1550,8 @@ void kip_configure_xdg_surface(void* data, struct xdg_surface* surface, uint32_t
 }
 
 void kip_toplevel_configuration(void* data, struct xdg_toplevel* toplevel, int32_t width, int32_t height, struct wl_array* states) {
+    KIP_TRACE_FUNCTION();
+
     if (!width && !height) {
         return;
     }
@@ -507,43 +1565,362 @@ void kip_toplevel_configuration(void* data, struct xdg_toplevel* toplevel, int32
 }
 
 void kip_toplevel_close(void* data, struct xdg_toplevel* toplevel) {
+    KIP_TRACE_FUNCTION();
+
     kip_window_data* windowData = &kipcornWindows[(kip_window)(uintptr_t)data];
 
     windowData->open = false;
 }
 
 void kip_toplevel_configure_bounds(void* data, struct xdg_toplevel* toplevel, int32_t width, int32_t height) {
-
+    KIP_TRACE_FUNCTION();
 }
 
 void kip_toplevel_wm_capabilities(void* data, struct xdg_toplevel* toplevel, struct wl_array* states) {
-
+    KIP_TRACE_FUNCTION();
 }
 
+#if KIPCORN_ENABLE_INPUT
 void kip_seat_capabilities(void* data, struct wl_seat* seat, uint32_t capabilities) {
-    context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    KIP_TRACE_FUNCTION();
 
-    keyboard = wl_seat_get_keyboard(seat);
-    wl_keyboard_add_listener(keyboard, &keyboardListener, NULL);
+#if KIPCORN_ENABLE_KEYBOARD
+    if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !keyboard) {
+        keyboard = wl_seat_get_keyboard(seat);
+        wl_keyboard_add_listener(keyboard, &keyboardListener, NULL);
+    }
+#endif
 
-    pointer = wl_seat_get_pointer(seat);
-    wl_pointer_add_listener(pointer, &pointerListener, NULL);
+#if KIPCORN_ENABLE_POINTER
+    if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && !pointer) {
+        pointer = wl_seat_get_pointer(seat);
+        wl_pointer_add_listener(pointer, &pointerListener, NULL);
+    }
+#endif
 }
 
 void kip_seat_name(void* data, struct wl_seat* seat, const char* name) {
-
+    KIP_TRACE_FUNCTION();
 }
+#endif
 
+#if KIPCORN_ENABLE_XKB
+uint64_t kip_keymap_hash(const char* string, uint32_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (uint32_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)string[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+kip_keymap* kip_keymap_compile(const char* string, uint64_t hash, uint32_t size, uint32_t sequence) {
+    KIP_TRACE_FUNCTION();
+
+    struct xkb_context* context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (!context) return NULL;
+
+    struct xkb_keymap* xkbKeymap = xkb_keymap_new_from_string(context, string, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (!xkbKeymap) {
+        xkb_context_unref(context);
+        return NULL;
+    }
+
+    uint32_t layoutTotal = 0;
+    uint32_t levelTotal = 0;
+    uint32_t entryTotal = 0;
+    xkb_mod_mask_t masks[KIPCORN_KEYMAP_LEVEL_MASKS];
+
+    for (uint32_t key = 0; key < KIPCORN_KEYCODE_COUNT; key++) {
+        xkb_layout_index_t layoutCount = xkb_keymap_num_layouts_for_key(xkbKeymap, key + 8);
+        layoutTotal += layoutCount;
+
+        for (xkb_layout_index_t layout = 0; layout < layoutCount; layout++) {
+            xkb_level_index_t levelCount = xkb_keymap_num_levels_for_key(xkbKeymap, key + 8, layout);
+            levelTotal += levelCount;
+
+            for (xkb_level_index_t level = 0; level < levelCount; level++) {
+                entryTotal += xkb_keymap_key_get_mods_for_level(xkbKeymap, key + 8, layout, level, masks, KIPCORN_KEYMAP_LEVEL_MASKS);
+            }
+        }
+    }
+
+    kip_keymap* keymap = calloc(1, sizeof(kip_keymap) + layoutTotal * sizeof(kip_keymap_layout) + levelTotal * sizeof(kip_keymap_level) + entryTotal * sizeof(kip_keymap_entry));
+
+    if (keymap) {
+        keymap->hash = hash;
+        keymap->size = size;
+        keymap->sequence = sequence;
+        keymap->layouts = (kip_keymap_layout*)(keymap + 1);
+        keymap->levels = (kip_keymap_level*)(keymap->layouts + layoutTotal);
+        keymap->entries = (kip_keymap_entry*)(keymap->levels + levelTotal);
+
+        const char* modifierNames[KIPCORN_MODIFIER_INDEX_COUNT] = {
+            XKB_MOD_NAME_SHIFT,
+            XKB_MOD_NAME_CAPS,
+            XKB_MOD_NAME_CTRL,
+            XKB_MOD_NAME_ALT,
+            XKB_MOD_NAME_NUM,
+            XKB_MOD_NAME_LOGO,
+        };
+
+        for (uint32_t i = 0; i < KIPCORN_MODIFIER_INDEX_COUNT; i++) {
+            xkb_mod_index_t index = xkb_keymap_mod_get_index(xkbKeymap, modifierNames[i]);
+            if (index < 32) keymap->modifierMasks[i] = 1u << index;
+        }
+
+        uint32_t layoutOffset = 0;
+        uint32_t levelOffset = 0;
+        uint32_t entryOffset = 0;
+
+        for (uint32_t key = 0; key < KIPCORN_KEYCODE_COUNT; key++) {
+            kip_keymap_key* keymapKey = &keymap->keys[key];
+            keymapKey->layoutOffset = layoutOffset;
+            keymapKey->layoutCount = xkb_keymap_num_layouts_for_key(xkbKeymap, key + 8);
+
+            for (xkb_layout_index_t layout = 0; layout < keymapKey->layoutCount; layout++) {
+                kip_keymap_layout* keymapLayout = &keymap->layouts[layoutOffset++];
+                keymapLayout->levelOffset = levelOffset;
+                keymapLayout->entryOffset = entryOffset;
+                keymapLayout->levelCount = xkb_keymap_num_levels_for_key(xkbKeymap, key + 8, layout);
+
+                for (xkb_level_index_t level = 0; level < keymapLayout->levelCount; level++) {
+                    kip_keymap_level* keymapLevel = &keymap->levels[levelOffset++];
+
+                    const xkb_keysym_t* keysyms;
+                    keymapLevel->keysym = xkb_keymap_key_get_syms_by_level(xkbKeymap, key + 8, layout, level, &keysyms) > 0 ? keysyms[0] : XKB_KEY_NoSymbol;
+                    keymapLevel->capitalKeysym = xkb_keysym_to_upper(keymapLevel->keysym);
+
+                    size_t maskCount = xkb_keymap_key_get_mods_for_level(xkbKeymap, key + 8, layout, level, masks, KIPCORN_KEYMAP_LEVEL_MASKS);
+
+                    for (size_t i = 0; i < maskCount; i++) {
+                        keymap->entries[entryOffset++] = (kip_keymap_entry){masks[i], level};
+                        keymapLayout->entryCount++;
+                        keymapLayout->typeMask |= masks[i];
+                    }
+                }
+            }
+        }
+    }
+
+    xkb_keymap_unref(xkbKeymap);
+    xkb_context_unref(context);
+    return keymap;
+}
+
+void kip_keymap_cache_insert(kip_keymap* keymap) {
+    uint32_t slot = 0;
+
+    for (uint32_t i = 0; i < KIPCORN_KEYMAP_CACHE_SIZE; i++) {
+        if (!keymapCache[i]) {
+            slot = i;
+            break;
+        }
+
+        if (keymapCache[i] == activeKeymap) continue;
+        if (keymapCache[slot] == activeKeymap || keymapCache[i]->lastUsed < keymapCache[slot]->lastUsed) slot = i;
+    }
+
+    free(keymapCache[slot]);
+    keymapCache[slot] = keymap;
+}
+
+void kip_keymap_activate(kip_keymap* keymap) {
+    keymap->lastUsed = ++keymapUseCounter;
+    activeKeymap = keymap;
+}
+
+void kip_keymap_cache_clear() {
+#if KIPCORN_ENABLE_THREADS
+    pthread_mutex_lock(&keymapMutex);
+    kip_keymap* compiled = compiledKeymaps;
+    compiledKeymaps = NULL;
+    keymapsCompiled = false;
+    pthread_mutex_unlock(&keymapMutex);
+
+    while (compiled) {
+        kip_keymap* next = compiled->next;
+        free(compiled);
+        compiled = next;
+    }
+#endif
+
+    for (uint32_t i = 0; i < KIPCORN_KEYMAP_CACHE_SIZE; i++) {
+        free(keymapCache[i]);
+        keymapCache[i] = NULL;
+    }
+
+    activeKeymap = NULL;
+}
+
+#if KIPCORN_ENABLE_THREADS
+void* kip_keymap_compile_thread(void* data) {
+    kip_keymap_job* job = data;
+    kip_keymap* keymap = kip_keymap_compile(job->string, job->hash, job->size, job->sequence);
+
+    free(job->string);
+    free(job);
+
+    if (keymap) {
+        pthread_mutex_lock(&keymapMutex);
+        keymap->next = compiledKeymaps;
+        compiledKeymaps = keymap;
+        __atomic_store_n(&keymapsCompiled, true, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&keymapMutex);
+    }
+
+    return NULL;
+}
+#endif
+
+void kip_keymap_install_compiled() {
+#if KIPCORN_ENABLE_THREADS
+    if (!__atomic_load_n(&keymapsCompiled, __ATOMIC_ACQUIRE)) return;
+
+    pthread_mutex_lock(&keymapMutex);
+    kip_keymap* compiled = compiledKeymaps;
+    compiledKeymaps = NULL;
+    keymapsCompiled = false;
+    pthread_mutex_unlock(&keymapMutex);
+
+    while (compiled) {
+        kip_keymap* next = compiled->next;
+        kip_keymap* keymap = compiled;
+
+        for (uint32_t i = 0; i < KIPCORN_KEYMAP_CACHE_SIZE; i++) {
+            if (keymapCache[i] && keymapCache[i]->hash == compiled->hash && keymapCache[i]->size == compiled->size) {
+                keymap = keymapCache[i];
+                keymap->sequence = compiled->sequence > keymap->sequence ? compiled->sequence : keymap->sequence;
+                free(compiled);
+                break;
+            }
+        }
+
+        if (keymap == compiled) kip_keymap_cache_insert(keymap);
+        if (keymap->sequence == keymapSequence) kip_keymap_activate(keymap);
+
+        compiled = next;
+    }
+#endif
+}
+
+uint32_t kip_key_get_keysym(kip_key key) {
+    if (!activeKeymap || (uint32_t)key >= KIPCORN_KEYCODE_COUNT) return XKB_KEY_NoSymbol;
+
+    kip_keymap_key* keymapKey = &activeKeymap->keys[key];
+    if (!keymapKey->layoutCount) return XKB_KEY_NoSymbol;
+
+    // Out of range groups wrap around, which is xkb's default for keys with fewer layouts.
+    kip_keymap_layout* layout = &activeKeymap->layouts[keymapKey->layoutOffset + keyboardXkbGroup % keymapKey->layoutCount];
+    uint32_t modifiers = keyboardXkbModifiers & layout->typeMask;
+    uint32_t level = 0;
+
+    for (uint32_t i = 0; i < layout->entryCount; i++) {
+        kip_keymap_entry* entry = &activeKeymap->entries[layout->entryOffset + i];
+        if (entry->mask == modifiers) {
+            level = entry->level;
+            break;
+        }
+    }
+
+    if (level >= layout->levelCount) return XKB_KEY_NoSymbol;
+
+    // Caps Lock capitalizes the result unless the key type already consumes it.
+    kip_keymap_level* keymapLevel = &activeKeymap->levels[layout->levelOffset + level];
+    uint32_t capsLock = activeKeymap->modifierMasks[KIPCORN_MODIFIER_INDEX_CAPS_LOCK];
+    bool capitalize = (keyboardXkbModifiers & capsLock) && !(layout->typeMask & capsLock);
+
+    return capitalize ? keymapLevel->capitalKeysym : keymapLevel->keysym;
+}
+
+uint32_t kip_keyboard_get_modifiers() {
+    if (!activeKeymap) return 0;
+
+    uint32_t modifiers = 0;
+    for (uint32_t i = 0; i < KIPCORN_MODIFIER_INDEX_COUNT; i++) {
+        if (keyboardXkbModifiers & activeKeymap->modifierMasks[i]) modifiers |= 1u << i;
+    }
+
+    return modifiers;
+}
+#endif
+
+#if KIPCORN_ENABLE_KEYBOARD
 void kip_keyboard_keymap(void* data, struct wl_keyboard* wl_keyboard, uint32_t format, int32_t fd, uint32_t size) {
-    char* keymapString = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    KIP_TRACE_FUNCTION();
+
+#if KIPCORN_ENABLE_XKB
+    char* keymapString = format == WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (keymapString == MAP_FAILED) return;
+
+    uint64_t hash = kip_keymap_hash(keymapString, size);
+    uint32_t sequence = ++keymapSequence;
+
+    for (uint32_t i = 0; i < KIPCORN_KEYMAP_CACHE_SIZE; i++) {
+        if (keymapCache[i] && keymapCache[i]->hash == hash && keymapCache[i]->size == size) {
+            kip_keymap_activate(keymapCache[i]);
+            munmap(keymapString, size);
+            return;
+        }
+    }
+
+#if KIPCORN_ENABLE_THREADS
+    kip_keymap_job* job = malloc(sizeof(kip_keymap_job));
+    char* string = malloc(size + 1);
+
+    if (job && string) {
+        memcpy(string, keymapString, size);
+        string[size] = 0;
+        munmap(keymapString, size);
+
+        job->string = string;
+        job->hash = hash;
+        job->size = size;
+        job->sequence = sequence;
+
+        pthread_t thread;
+        if (!pthread_create(&thread, NULL, kip_keymap_compile_thread, job)) {
+            pthread_detach(thread);
+            return;
+        }
+
+        kip_keymap* keymap = kip_keymap_compile(string, hash, size, sequence);
+        if (keymap) {
+            kip_keymap_cache_insert(keymap);
+            kip_keymap_activate(keymap);
+        }
+
+        free(string);
+        free(job);
+        return;
+    }
+
+    free(job);
+    free(string);
+#endif
+
+    kip_keymap* keymap = kip_keymap_compile(keymapString, hash, size, sequence);
+    if (keymap) {
+        kip_keymap_cache_insert(keymap);
+        kip_keymap_activate(keymap);
+    }
 
-    keymap = xkb_keymap_new_from_string(context, keymapString, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
-    xkbState = xkb_state_new(keymap);
     munmap(keymapString, size);
+#else
     close(fd);
+#endif
 }
 
 void kip_keyboard_enter(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, struct wl_surface* surface, struct wl_array* keys) {
+    KIP_TRACE_FUNCTION();
+
+#if KIPCORN_ENABLE_CLIPBOARD
+    inputSerial = serial;
+#endif
+
     for (uint32_t i = 0; i < kipcornWindowCount; i++) {
         if (kipcornWindows[i].waylandSurface == surface) {
             keyboardFocusedKipcornWindow = i;
@@ -552,6 +1929,8 @@ void kip_keyboard_enter(void* data, struct wl_keyboard* wl_keyboard, uint32_t se
 }
 
 void kip_keyboard_leave(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, struct wl_surface* surface) {
+    KIP_TRACE_FUNCTION();
+
     for (uint32_t i = 0; i < kipcornWindowCount; i++) {
         if (kipcornWindows[i].waylandSurface == surface && keyboardFocusedKipcornWindow == i) {
             keyboardFocusedKipcornWindow = KIPCORN_WINDOW_INVALID;
@@ -560,9 +1939,13 @@ void kip_keyboard_leave(void* data, struct wl_keyboard* wl_keyboard, uint32_t se
 }
 
 void kip_keyboard_key(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state) {
+    KIP_TRACE_FUNCTION();
+
     if (!kipcornWindows) return;
 
-    xkb_state_update_key(xkbState, key + 8, state ? XKB_KEY_DOWN : XKB_KEY_UP);
+#if KIPCORN_ENABLE_CLIPBOARD
+    inputSerial = serial;
+#endif
 
     if (keyboardFocusedKipcornWindow < kipcornWindowCount && key < 139) {
         kipcornWindows[keyboardFocusedKipcornWindow].keyStates[key] = state;
@@ -570,14 +1953,23 @@ void kip_keyboard_key(void* data, struct wl_keyboard* wl_keyboard, uint32_t seri
 }
 
 void kip_keyboard_modifiers(void* data, struct wl_keyboard* wl_keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group) {
+    KIP_TRACE_FUNCTION();
 
+#if KIPCORN_ENABLE_XKB
+    keyboardXkbModifiers = mods_depressed | mods_latched | mods_locked;
+    keyboardXkbGroup = group;
+#endif
 }
 
 void kip_keyboard_repeat_info(void* data, struct wl_keyboard* wl_keyboard, int32_t rate, int32_t delay) {
-
+    KIP_TRACE_FUNCTION();
 }
+#endif
 
+#if KIPCORN_ENABLE_POINTER
 void kip_pointer_enter(void *data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface, wl_fixed_t surface_x, wl_fixed_t surface_y) {
+    KIP_TRACE_FUNCTION();
+
     for (uint32_t i = 0; i < kipcornWindowCount; i++) {
         if (kipcornWindows[i].waylandSurface == surface) {
             pointerFocusedKipcornWindow = i;
@@ -586,6 +1978,8 @@ void kip_pointer_enter(void *data, struct wl_pointer* wl_pointer, uint32_t seria
 }
 
 void kip_pointer_leave(void *data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface) {
+    KIP_TRACE_FUNCTION();
+
     for (uint32_t i = 0; i < kipcornWindowCount; i++) {
         if (kipcornWindows[i].waylandSurface == surface && pointerFocusedKipcornWindow == i) {
             pointerFocusedKipcornWindow = KIPCORN_WINDOW_INVALID;
@@ -594,6 +1988,8 @@ void kip_pointer_leave(void *data, struct wl_pointer* wl_pointer, uint32_t seria
 }
 
 void kip_pointer_motion(void *data, struct wl_pointer* wl_pointer, uint32_t time, wl_fixed_t surface_x, wl_fixed_t surface_y) {
+    KIP_TRACE_FUNCTION();
+
     if (pointerFocusedKipcornWindow >= kipcornWindowCount) return;
     if (!kipcornWindows) return;
 
@@ -602,14 +1998,503 @@ void kip_pointer_motion(void *data, struct wl_pointer* wl_pointer, uint32_t time
 }
 
 void kip_pointer_button(void *data, struct wl_pointer* wl_pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state) {
+    KIP_TRACE_FUNCTION();
+
+#if KIPCORN_ENABLE_CLIPBOARD
+    if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
+        inputSerial = serial;
+        pointerButtonSerial = serial;
+    }
+#endif
+}
+
+void kip_pointer_axis(void *data, struct wl_pointer* wl_pointer, uint32_t time, uint32_t axis, wl_fixed_t value) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_pointer_frame(void *data, struct wl_pointer* wl_pointer) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_pointer_axis_source(void *data, struct wl_pointer* wl_pointer, uint32_t axis_source) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_pointer_axis_stop(void *data, struct wl_pointer* wl_pointer, uint32_t time, uint32_t axis) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_pointer_axis_discrete(void *data, struct wl_pointer* wl_pointer, uint32_t axis, int32_t discrete) {
+    KIP_TRACE_FUNCTION();
+}
+#endif
+
+#if KIPCORN_ENABLE_CLIPBOARD
+void kip_transfer_copy(kip_transfer* transfer) {
+    KIP_TRACE_FUNCTION();
+
+    sigset_t pipeSignal;
+    sigset_t oldMask;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &oldMask);
+
+    // Prefer splice, then sendfile, and only copy through userspace when neither fd supports them.
+    uint32_t mode = 0;
+    char* buffer = NULL;
+    transfer->success = true;
+
+    while (transfer->transferred < transfer->size) {
+        uint64_t remaining = transfer->size - transfer->transferred;
+        size_t chunk = remaining < KIPCORN_TRANSFER_CHUNK ? remaining : KIPCORN_TRANSFER_CHUNK;
+        loff_t offset = transfer->offset;
+        ssize_t moved;
+
+        if (mode == 0) {
+            moved = splice(transfer->from, transfer->offset >= 0 ? &offset : NULL, transfer->to, NULL, chunk, SPLICE_F_MOVE);
+        } else if (mode == 1) {
+            moved = sendfile(transfer->to, transfer->from, transfer->offset >= 0 ? &offset : NULL, chunk);
+        } else {
+            if (!buffer) buffer = malloc(KIPCORN_TRANSFER_CHUNK);
+            if (!buffer) {
+                transfer->success = false;
+                break;
+            }
+
+            moved = transfer->offset >= 0 ? pread(transfer->from, buffer, chunk, offset) : read(transfer->from, buffer, chunk);
+            for (ssize_t written = 0; moved > 0 && written < moved;) {
+                ssize_t result = write(transfer->to, buffer + written, moved - written);
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) {
+                    moved = -1;
+                    break;
+                }
+                written += result;
+            }
+            if (moved > 0) offset += moved;
+        }
+
+        if (moved < 0) {
+            if (errno == EINTR) continue;
+            if (mode < 2 && (errno == EINVAL || errno == ENOSYS)) {
+                mode++;
+                continue;
+            }
+
+            transfer->success = false;
+            break;
+        }
+
+        if (moved == 0) break;
+
+        transfer->transferred += moved;
+        if (transfer->offset >= 0) transfer->offset = offset;
+    }
+
+    free(buffer);
+
+    struct timespec noWait = {0, 0};
+    while (sigtimedwait(&pipeSignal, NULL, &noWait) == SIGPIPE);
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+}
+
+void kip_transfer_finish(kip_transfer* transfer) {
+    close(transfer->from);
+    close(transfer->to);
+
+    if (!transfer->callback && !transfer->offer) {
+        free(transfer->mimeType);
+        free(transfer);
+        return;
+    }
+
+    pthread_mutex_lock(&transferMutex);
+    transfer->next = finishedTransfers;
+    finishedTransfers = transfer;
+    __atomic_store_n(&transfersFinished, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&transferMutex);
+}
+
+void* kip_transfer_thread(void* data) {
+    kip_transfer_copy(data);
+    kip_transfer_finish(data);
+    return NULL;
+}
+
+// Copies never run on the dispatch thread: reading our own selection there would wait on a
+// wl_data_source.send that only this thread can dispatch. Without a thread the transfer fails.
+void kip_transfer_start(kip_transfer* transfer) {
+    pthread_t thread;
+    if (!pthread_create(&thread, NULL, kip_transfer_thread, transfer)) {
+        pthread_detach(thread);
+        return;
+    }
 
+    transfer->success = false;
+    kip_transfer_finish(transfer);
 }
 
+void kip_data_offer_destroy(kip_data_offer* offer) {
+    if (!offer) return;
+
+    for (uint32_t i = 0; i < offer->mimeTypeCount; i++) {
+        free(offer->mimeTypes[i]);
+    }
+
+    wl_data_offer_destroy(offer->offer);
+    free(offer);
+}
+
+bool kip_data_offer_has_mime_type(kip_data_offer* offer, const char* mimeType) {
+    if (!offer || !mimeType) return false;
+
+    for (uint32_t i = 0; i < offer->mimeTypeCount; i++) {
+        if (!strcmp(offer->mimeTypes[i], mimeType)) return true;
+    }
+
+    return false;
+}
+
+void kip_data_source_destroy(kip_data_source* source) {
+    if (!source) return;
+
+    wl_data_source_destroy(source->source);
+    close(source->fd);
+    free(source->mimeType);
+    free(source);
+}
+
+void kip_transfer_dispatch_finished() {
+    if (!__atomic_load_n(&transfersFinished, __ATOMIC_ACQUIRE)) return;
+
+    pthread_mutex_lock(&transferMutex);
+    kip_transfer* transfer = finishedTransfers;
+    finishedTransfers = NULL;
+    transfersFinished = false;
+    pthread_mutex_unlock(&transferMutex);
+
+    while (transfer) {
+        kip_transfer* next = transfer->next;
+
+        if (transfer->offer) {
+            if (transfer->success && wl_data_offer_get_version(transfer->offer->offer) >= 3) wl_data_offer_finish(transfer->offer->offer);
+            kip_data_offer_destroy(transfer->offer);
+            lseek(transfer->callbackFd, 0, SEEK_SET);
+        }
+
+        if (transfer->callback) transfer->callback(transfer->window, transfer->mimeType, transfer->callbackFd, transfer->transferred, transfer->success, transfer->userData);
+
+        free(transfer->mimeType);
+        free(transfer);
+        transfer = next;
+    }
+}
+
+bool kip_data_offer_receive(kip_data_offer* offer, const char* mimeType, int32_t fd, int32_t callbackFd, kip_window window, kip_transfer_callback callback, void* userData, bool ownOffer) {
+    int32_t pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC)) return false;
+
+    kip_transfer* transfer = calloc(1, sizeof(kip_transfer));
+    char* mimeTypeCopy = strdup(mimeType);
+    if (!transfer || !mimeTypeCopy) {
+        free(transfer);
+        free(mimeTypeCopy);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        return false;
+    }
+
+    wl_data_offer_receive(offer->offer, mimeType, pipeFds[1]);
+    close(pipeFds[1]);
+    wl_display_flush(display);
+
+    transfer->from = pipeFds[0];
+    transfer->to = fd;
+    transfer->offset = -1;
+    transfer->size = UINT64_MAX;
+    transfer->window = window;
+    transfer->mimeType = mimeTypeCopy;
+    transfer->callbackFd = callbackFd;
+    transfer->offer = ownOffer ? offer : NULL;
+    transfer->callback = callback;
+    transfer->userData = userData;
+
+    kip_transfer_start(transfer);
+    return true;
+}
+
+kip_data_source* kip_data_source_create(const char* mimeType, int32_t fd, uint64_t size) {
+    if (!dataDeviceManager || !dataDevice) return NULL;
+
+    kip_data_source* source = calloc(1, sizeof(kip_data_source));
+    if (!source) return NULL;
+
+    source->mimeType = strdup(mimeType);
+    if (!source->mimeType) {
+        free(source);
+        return NULL;
+    }
+
+    source->fd = fd;
+    source->size = size;
+    source->source = wl_data_device_manager_create_data_source(dataDeviceManager);
+    wl_data_source_add_listener(source->source, &dataSourceListener, source);
+    wl_data_source_offer(source->source, mimeType);
+
+    return source;
+}
+
+void kip_data_device_create() {
+    if (!dataDeviceManager || !seat || dataDevice) return;
+
+    dataDevice = wl_data_device_manager_get_data_device(dataDeviceManager, seat);
+    wl_data_device_add_listener(dataDevice, &dataDeviceListener, NULL);
+}
+
+bool kip_clipboard_set(const char* mimeType, int32_t fd, uint64_t size) {
+    kip_data_source* source = kip_data_source_create(mimeType, fd, size);
+    if (!source) {
+        close(fd);
+        return false;
+    }
+
+    wl_data_device_set_selection(dataDevice, source->source, inputSerial);
+    kip_data_source_destroy(selectionSource);
+    selectionSource = source;
+
+    return true;
+}
+
+bool kip_clipboard_set_data(const char* mimeType, const void* data, uint64_t size) {
+    int32_t fd = memfd_create("kipcorn-clipboard", MFD_CLOEXEC);
+    if (fd < 0) return false;
+
+    for (uint64_t written = 0; written < size;) {
+        ssize_t result = write(fd, (const char*)data + written, size - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            close(fd);
+            return false;
+        }
+        written += result;
+    }
+
+    return kip_clipboard_set(mimeType, fd, size);
+}
+
+bool kip_clipboard_has_mime_type(const char* mimeType) {
+    return kip_data_offer_has_mime_type(selectionOffer, mimeType);
+}
+
+bool kip_clipboard_receive(const char* mimeType, int32_t fd, kip_transfer_callback callback, void* userData) {
+    if (!kip_data_offer_has_mime_type(selectionOffer, mimeType)) return false;
+
+    int32_t destination = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (destination < 0) return false;
+
+    if (!kip_data_offer_receive(selectionOffer, mimeType, destination, fd, KIPCORN_WINDOW_INVALID, callback, userData, false)) {
+        close(destination);
+        return false;
+    }
+
+    return true;
+}
+
+bool kip_drag_start(kip_window window, const char* mimeType, int32_t fd, uint64_t size) {
+    kip_data_source* source = kip_data_source_create(mimeType, fd, size);
+    if (!source) {
+        close(fd);
+        return false;
+    }
+
+    if (wl_data_source_get_version(source->source) >= 3) wl_data_source_set_actions(source->source, WL_DATA_DEVICE_MANAGER_DND_ACTION_COPY);
+    wl_data_device_start_drag(dataDevice, source->source, kipcornWindows[window].waylandSurface, NULL, pointerButtonSerial);
+    kip_data_source_destroy(dragSource);
+    dragSource = source;
+
+    return true;
+}
+
+void kip_set_drop_handler(const char* mimeType, kip_transfer_callback callback, void* userData) {
+    free(dropMimeType);
+    dropMimeType = mimeType ? strdup(mimeType) : NULL;
+    dropCallback = callback;
+    dropUserData = userData;
+}
+
+void kip_clipboard_shutdown() {
+    kip_data_offer_destroy(selectionOffer);
+    kip_data_offer_destroy(dragOffer);
+    kip_data_source_destroy(selectionSource);
+    kip_data_source_destroy(dragSource);
+    selectionOffer = NULL;
+    dragOffer = NULL;
+    selectionSource = NULL;
+    dragSource = NULL;
+
+    if (dataDevice && wl_data_device_get_version(dataDevice) >= 2) wl_data_device_release(dataDevice);
+    else if (dataDevice) wl_data_device_destroy(dataDevice);
+    if (dataDeviceManager) wl_data_device_manager_destroy(dataDeviceManager);
+    dataDevice = NULL;
+    dataDeviceManager = NULL;
+
+    kip_set_drop_handler(NULL, NULL, NULL);
+}
+
+void kip_data_device_data_offer(void* data, struct wl_data_device* wl_data_device, struct wl_data_offer* id) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer* offer = calloc(1, sizeof(kip_data_offer));
+    if (!offer) {
+        wl_data_offer_destroy(id);
+        return;
+    }
+
+    offer->offer = id;
+    wl_data_offer_add_listener(id, &dataOfferListener, offer);
+}
+
+void kip_data_device_enter(void* data, struct wl_data_device* wl_data_device, uint32_t serial, struct wl_surface* surface, wl_fixed_t x, wl_fixed_t y, struct wl_data_offer* id) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer_destroy(dragOffer);
+    dragOffer = id ? wl_data_offer_get_user_data(id) : NULL;
+    dragWindow = KIPCORN_WINDOW_INVALID;
+    dragSerial = serial;
+    dragAccepted = false;
+
+    for (uint32_t i = 0; i < kipcornWindowCount; i++) {
+        if (kipcornWindows[i].waylandSurface == surface) dragWindow = i;
+    }
+
+    if (!dragOffer) return;
+
+    dragAccepted = dropCallback && kip_data_offer_has_mime_type(dragOffer, dropMimeType);
+    wl_data_offer_accept(dragOffer->offer, serial, dragAccepted ? dropMimeType : NULL);
+
+    if (wl_data_offer_get_version(dragOffer->offer) >= 3) {
+        uint32_t action = dragAccepted ? WL_DATA_DEVICE_MANAGER_DND_ACTION_COPY : WL_DATA_DEVICE_MANAGER_DND_ACTION_NONE;
+        wl_data_offer_set_actions(dragOffer->offer, action, action);
+    }
+}
+
+void kip_data_device_leave(void* data, struct wl_data_device* wl_data_device) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer_destroy(dragOffer);
+    dragOffer = NULL;
+    dragWindow = KIPCORN_WINDOW_INVALID;
+}
+
+void kip_data_device_motion(void* data, struct wl_data_device* wl_data_device, uint32_t time, wl_fixed_t x, wl_fixed_t y) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_data_device_drop(void* data, struct wl_data_device* wl_data_device) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer* offer = dragOffer;
+    dragOffer = NULL;
+    if (!offer) return;
+
+    int32_t fd = dragAccepted ? memfd_create("kipcorn-drop", MFD_CLOEXEC) : -1;
+    int32_t destination = fd >= 0 ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1;
+
+    // The offer has to stay alive until the data is read, so the transfer owns it from here.
+    if (destination < 0 || !kip_data_offer_receive(offer, dropMimeType, destination, fd, dragWindow, dropCallback, dropUserData, true)) {
+        if (fd >= 0) close(fd);
+        if (destination >= 0) close(destination);
+        kip_data_offer_destroy(offer);
+    }
+}
+
+void kip_data_device_selection(void* data, struct wl_data_device* wl_data_device, struct wl_data_offer* id) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer_destroy(selectionOffer);
+    selectionOffer = id ? wl_data_offer_get_user_data(id) : NULL;
+}
+
+void kip_data_offer_offer(void* data, struct wl_data_offer* wl_data_offer, const char* mime_type) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_offer* offer = data;
+    if (offer->mimeTypeCount >= KIPCORN_DATA_OFFER_MIME_TYPES) return;
+
+    char* mimeType = strdup(mime_type);
+    if (mimeType) offer->mimeTypes[offer->mimeTypeCount++] = mimeType;
+}
+
+void kip_data_offer_source_actions(void* data, struct wl_data_offer* wl_data_offer, uint32_t source_actions) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_data_offer_action(void* data, struct wl_data_offer* wl_data_offer, uint32_t dnd_action) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_data_source_target(void* data, struct wl_data_source* wl_data_source, const char* mime_type) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_data_source_send(void* data, struct wl_data_source* wl_data_source, const char* mime_type, int32_t fd) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_source* source = data;
+    int32_t from = strcmp(mime_type, source->mimeType) ? -1 : fcntl(source->fd, F_DUPFD_CLOEXEC, 0);
+    kip_transfer* transfer = from >= 0 ? calloc(1, sizeof(kip_transfer)) : NULL;
+
+    if (!transfer) {
+        if (from >= 0) close(from);
+        close(fd);
+        return;
+    }
+
+    transfer->from = from;
+    transfer->to = fd;
+    transfer->offset = 0;
+    transfer->size = source->size;
+
+    kip_transfer_start(transfer);
+}
+
+void kip_data_source_cancelled(void* data, struct wl_data_source* wl_data_source) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_source* source = data;
+    if (source == selectionSource) selectionSource = NULL;
+    if (source == dragSource) dragSource = NULL;
+
+    kip_data_source_destroy(source);
+}
+
+void kip_data_source_dnd_drop_performed(void* data, struct wl_data_source* wl_data_source) {
+    KIP_TRACE_FUNCTION();
+}
+
+void kip_data_source_dnd_finished(void* data, struct wl_data_source* wl_data_source) {
+    KIP_TRACE_FUNCTION();
+
+    kip_data_source* source = data;
+    if (source == dragSource) dragSource = NULL;
+
+    kip_data_source_destroy(source);
+}
+
+void kip_data_source_action(void* data, struct wl_data_source* wl_data_source, uint32_t dnd_action) {
+    KIP_TRACE_FUNCTION();
+}
+#endif
+
 void kip_xdg_ping(void* data, struct xdg_wm_base* shell, uint32_t serial) {
+    KIP_TRACE_FUNCTION();
+
     xdg_wm_base_pong(shell, serial);
 }
 
 void kip_registry_global(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version) {
+    KIP_TRACE_FUNCTION();
+
     if (!strcmp(interface, wl_compositor_interface.name)) {
         compositor = wl_registry_bind(registry, name, &wl_compositor_interface, KIPCORN_WL_VERSION);
     }
@@ -622,15 +2507,38 @@ void kip_registry_global(void* data, struct wl_registry* registry, uint32_t name
         shell = wl_registry_bind(registry, name, &xdg_wm_base_interface, version);
         xdg_wm_base_add_listener(shell, &shListener, NULL);
     }
+#if KIPCORN_ENABLE_DECORATIONS
     else if (!strcmp(interface, zxdg_decoration_manager_v1_interface.name)) {
         decorationManager = wl_registry_bind(registry, name, &zxdg_decoration_manager_v1_interface, 1);
     }
+#endif
+#if KIPCORN_ENABLE_TEARING_CONTROL
+    else if (!strcmp(interface, wp_tearing_control_manager_v1_interface.name)) {
+        tearingControlManager = wl_registry_bind(registry, name, &wp_tearing_control_manager_v1_interface, 1);
+    }
+#endif
+#if KIPCORN_ENABLE_CONTENT_TYPE
+    else if (!strcmp(interface, wp_content_type_manager_v1_interface.name)) {
+        contentTypeManager = wl_registry_bind(registry, name, &wp_content_type_manager_v1_interface, 1);
+    }
+#endif
+#if KIPCORN_ENABLE_INPUT
     else if (!strcmp(interface, wl_seat_interface.name)) {
-        seat = wl_registry_bind(registry, name, &wl_seat_interface, 1);
+        seat = wl_registry_bind(registry, name, &wl_seat_interface, version < 5 ? version : 5);
         wl_seat_add_listener(seat, &seatListener, NULL);
+#if KIPCORN_ENABLE_CLIPBOARD
+        kip_data_device_create();
+#endif
     }
+#endif
+#if KIPCORN_ENABLE_CLIPBOARD
+    else if (!strcmp(interface, wl_data_device_manager_interface.name)) {
+        dataDeviceManager = wl_registry_bind(registry, name, &wl_data_device_manager_interface, version < 3 ? version : 3);
+        kip_data_device_create();
+    }
+#endif
 }
 
 void kip_registry_global_remove(void* data, struct wl_registry* registry, uint32_t name) {
-
+    KIP_TRACE_FUNCTION();
 }
\ No newline at end of file
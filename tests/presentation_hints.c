@@ -0,0 +1,90 @@
+#include <kipcorn/kipcorn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wayland-client-core.h>
+#include "content-type-v1.h"
+#include "tearing-control-v1.h"
+#include "stand_in_server.h"
+
+#if KIPCORN_ENABLE_TEARING_CONTROL && KIPCORN_ENABLE_CONTENT_TYPE
+uint32_t failures = 0;
+
+void check(bool condition, const char* description) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", description);
+        failures++;
+    }
+}
+
+// Each client runs in a child process, with the result of every setter in its exit status.
+int client_with_globals() {
+    kip_init();
+    kip_window window = kip_create_window(64, 64, "presentation hints", KIPCORN_GRAPHICS_BACKEND_SOFTWARE, true, false, false, NULL);
+    if (window == KIPCORN_WINDOW_INVALID) return 1;
+
+    kip_set_vsync(window, false);
+    if (!kip_set_allow_tearing(window, true)) return 2;
+    if (!kip_set_content_type(window, KIPCORN_CONTENT_TYPE_GAME)) return 3;
+    kip_set_vsync(window, true);
+
+    wl_display_roundtrip(kip_get_wayland_display());
+    kip_shutdown();
+    return 0;
+}
+
+int client_without_globals() {
+    kip_init();
+    kip_window window = kip_create_window(64, 64, "presentation hints", KIPCORN_GRAPHICS_BACKEND_SOFTWARE, false, false, false, NULL);
+    if (window == KIPCORN_WINDOW_INVALID) return 1;
+
+    if (kip_set_allow_tearing(window, true)) return 2;
+    if (kip_set_content_type(window, KIPCORN_CONTENT_TYPE_GAME)) return 3;
+
+    wl_display_roundtrip(kip_get_wayland_display());
+    kip_shutdown();
+    return 0;
+}
+
+int run_client(stand_in_server* server, int (*client)()) {
+    fflush(NULL);
+
+    pid_t child = fork();
+    if (child < 0) return -1;
+    if (!child) _exit(client());
+
+    return stand_in_server_run(server, child);
+}
+
+int main() {
+    char runtimeDirectory[] = "/tmp/kipcorn-test-XXXXXX";
+    if (!mkdtemp(runtimeDirectory)) return 1;
+    setenv("XDG_RUNTIME_DIR", runtimeDirectory, 1);
+
+    stand_in_server server;
+
+    check(stand_in_server_start(&server, true), "server starts with presentation globals");
+    check(run_client(&server, client_with_globals) == 0, "setters succeed when the globals are advertised");
+    check(server.presentationHintCount == 3, "one presentation hint per vsync or tearing change");
+    check(server.presentationHintCount > 1 && server.presentationHints[1] == WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC, "async hint with vsync off and tearing allowed");
+    check(server.presentationHintCount > 0 && server.presentationHints[server.presentationHintCount - 1] == WP_TEARING_CONTROL_V1_PRESENTATION_HINT_VSYNC, "vsync hint after vsync is turned back on");
+    check(server.contentTypeCount == 1 && server.contentTypes[0] == WP_CONTENT_TYPE_V1_TYPE_GAME, "game content type reaches the server");
+    stand_in_server_stop(&server);
+
+    check(stand_in_server_start(&server, false), "server starts without presentation globals");
+    check(run_client(&server, client_without_globals) == 0, "setters report failure when the globals are missing");
+    check(server.presentationHintCount == 0 && server.contentTypeCount == 0, "no presentation requests without the globals");
+    stand_in_server_stop(&server);
+
+    rmdir(runtimeDirectory);
+
+    if (failures) return 1;
+    printf("presentation hints: ok\n");
+    return 0;
+}
+#else
+int main() {
+    printf("presentation hints: skipped, TEARING_CONTROL and CONTENT_TYPE are required\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,109 @@
+#define _GNU_SOURCE 1
+#include "stand_in_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <wayland-server-core.h>
+
+extern const struct wl_interface wl_compositor_interface;
+extern const struct wl_interface xdg_wm_base_interface;
+extern const struct wl_interface wp_tearing_control_manager_v1_interface;
+extern const struct wl_interface wp_tearing_control_v1_interface;
+extern const struct wl_interface wp_content_type_manager_v1_interface;
+extern const struct wl_interface wp_content_type_v1_interface;
+
+// Every object shares this dispatcher. It creates the objects a request asks for, records the
+// presentation requests and honours destroy, which is all kipcorn needs from a compositor.
+int stand_in_server_dispatch(const void* implementation, void* target, uint32_t opcode, const struct wl_message* message, union wl_argument* arguments) {
+    struct wl_resource* resource = target;
+    stand_in_server* server = wl_resource_get_user_data(resource);
+    const char* interface = wl_resource_get_class(resource);
+
+    uint32_t argument = 0;
+    for (const char* signature = message->signature; *signature; signature++) {
+        if ((*signature >= '0' && *signature <= '9') || *signature == '?') continue;
+
+        if (*signature == 'n' && message->types[argument]) {
+            struct wl_resource* object = wl_resource_create(wl_resource_get_client(resource), message->types[argument], wl_resource_get_version(resource), arguments[argument].n);
+            if (object) wl_resource_set_dispatcher(object, stand_in_server_dispatch, NULL, server, NULL);
+        }
+
+        argument++;
+    }
+
+    if (!strcmp(interface, wp_tearing_control_v1_interface.name) && !strcmp(message->name, "set_presentation_hint")) {
+        if (server->presentationHintCount < STAND_IN_SERVER_MAX_REQUESTS) server->presentationHints[server->presentationHintCount++] = arguments[0].u;
+    } else if (!strcmp(interface, wp_content_type_v1_interface.name) && !strcmp(message->name, "set_content_type")) {
+        if (server->contentTypeCount < STAND_IN_SERVER_MAX_REQUESTS) server->contentTypes[server->contentTypeCount++] = arguments[0].u;
+    }
+
+    if (!strcmp(message->name, "destroy")) wl_resource_destroy(resource);
+
+    return 0;
+}
+
+void stand_in_server_bind(struct wl_client* client, void* data, uint32_t version, uint32_t id) {
+    stand_in_global* global = data;
+
+    struct wl_resource* resource = wl_resource_create(client, global->interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_dispatcher(resource, stand_in_server_dispatch, NULL, global->server, NULL);
+}
+
+bool stand_in_server_add_global(stand_in_server* server, const struct wl_interface* interface, uint32_t version) {
+    for (uint32_t i = 0; i < STAND_IN_SERVER_MAX_GLOBALS; i++) {
+        stand_in_global* global = &server->globals[i];
+        if (global->interface) continue;
+
+        global->server = server;
+        global->interface = interface;
+        return wl_global_create(server->display, interface, version, global, stand_in_server_bind);
+    }
+
+    return false;
+}
+
+bool stand_in_server_start(stand_in_server* server, bool presentationGlobals) {
+    memset(server, 0, sizeof(stand_in_server));
+
+    server->display = wl_display_create();
+    if (!server->display) return false;
+
+    const char* socket = wl_display_add_socket_auto(server->display);
+    if (!socket) return false;
+    setenv("WAYLAND_DISPLAY", socket, 1);
+
+    if (!stand_in_server_add_global(server, &wl_compositor_interface, 4)) return false;
+    if (!stand_in_server_add_global(server, &xdg_wm_base_interface, 1)) return false;
+
+    if (presentationGlobals) {
+        if (!stand_in_server_add_global(server, &wp_tearing_control_manager_v1_interface, 1)) return false;
+        if (!stand_in_server_add_global(server, &wp_content_type_manager_v1_interface, 1)) return false;
+    }
+
+    return true;
+}
+
+int stand_in_server_run(stand_in_server* server, pid_t child) {
+    struct wl_event_loop* loop = wl_display_get_event_loop(server->display);
+
+    for (;;) {
+        wl_event_loop_dispatch(loop, 10);
+        wl_display_flush_clients(server->display);
+
+        int status;
+        pid_t result = waitpid(child, &status, WNOHANG);
+        if (result == child) return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        if (result < 0) return -1;
+    }
+}
+
+void stand_in_server_stop(stand_in_server* server) {
+    if (server->display) wl_display_destroy(server->display);
+    server->display = NULL;
+}
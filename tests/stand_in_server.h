@@ -0,0 +1,35 @@
+#ifndef KIPCORN_STAND_IN_SERVER
+#define KIPCORN_STAND_IN_SERVER
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define STAND_IN_SERVER_MAX_GLOBALS 4
+#define STAND_IN_SERVER_MAX_REQUESTS 32
+
+typedef struct stand_in_server stand_in_server;
+
+typedef struct stand_in_global {
+    stand_in_server* server;
+    const struct wl_interface* interface;
+} stand_in_global;
+
+// A compositor that only records requests. It advertises wl_compositor and xdg_wm_base, plus
+// the tearing control and content type managers when presentationGlobals is set.
+struct stand_in_server {
+    struct wl_display* display;
+    stand_in_global globals[STAND_IN_SERVER_MAX_GLOBALS];
+    uint32_t presentationHints[STAND_IN_SERVER_MAX_REQUESTS];
+    uint32_t presentationHintCount;
+    uint32_t contentTypes[STAND_IN_SERVER_MAX_REQUESTS];
+    uint32_t contentTypeCount;
+};
+
+// Listens on a new socket in XDG_RUNTIME_DIR and points WAYLAND_DISPLAY at it.
+bool stand_in_server_start(stand_in_server* server, bool presentationGlobals);
+// Serves clients until the child exits and returns its exit status, or -1 if it crashed.
+int stand_in_server_run(stand_in_server* server, pid_t child);
+void stand_in_server_stop(stand_in_server* server);
+
+#endif